@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// Minimal timing helpers shared by the benchmarks
+namespace Bench {
+  // Written by keep(), a volatile store the compiler has to perform
+  inline const void *volatile sink = nullptr;
+
+  // Prevents the compiler from optimizing away a computed value
+  template <typename T>
+  inline void keep(const T& value) {
+    sink = &value;
+  }
+
+  // Runs fn() repeatedly and returns the best time of one call in microseconds
+  template <typename Function>
+  double measure(Function&& fn, size_t iterations, size_t repeats = 5) {
+    double best = 0;
+
+    for (size_t r = 0; r < repeats; ++r) {
+      auto start = std::chrono::steady_clock::now();
+
+      for (size_t i = 0; i < iterations; ++i) {
+        fn();
+      }
+
+      auto end = std::chrono::steady_clock::now();
+      double us = std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+
+      if (r == 0 || us < best) {
+        best = us;
+      }
+    }
+
+    return best;
+  }
+
+  // Sorted .raw files of dir. If dir has none, it is filled with the given number
+  // of synthetic frames of beams x vals samples first
+  inline std::vector<std::string> prepareFrames(const std::filesystem::path& dir, size_t frames, int beams, int vals) {
+    std::vector<std::string> files;
+
+    std::filesystem::create_directories(dir);
+
+    for (const auto& p : std::filesystem::directory_iterator(dir)) {
+      if (p.path().extension() == ".raw") {
+        files.push_back(p.path().string());
+      }
+    }
+
+    if (!files.empty()) {
+      std::sort(files.begin(), files.end());
+      return files;
+    }
+
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> dist(-2000, 2000);
+    std::vector<short> frame((size_t) beams * vals);
+
+    for (size_t f = 0; f < frames; ++f) {
+      char name[32];
+      std::snprintf(name, sizeof(name), "frame_%04zu.raw", f);
+
+      for (auto& v : frame) {
+        v = (short) dist(gen);
+      }
+
+      const std::string path = (dir / name).string();
+      FILE *out = std::fopen(path.c_str(), "wb");
+
+      std::fwrite(frame.data(), sizeof(short), frame.size(), out);
+      std::fclose(out);
+
+      files.push_back(path);
+    }
+
+    return files;
+  }
+
+  inline void report(const std::string& name, double us, double baselineUs = 0) {
+    if (baselineUs > 0) {
+      std::printf("%-40s %12.3f us  (x%.2f)\n", name.c_str(), us, baselineUs / us);
+    } else {
+      std::printf("%-40s %12.3f us\n", name.c_str(), us);
+    }
+  }
+}
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <FFTransformer.h>
+
+#include "bench.h"
+#include "legacy/FFTransformer.h"
+
+using Complex = dsperado::Complex<double>;
+
+// Compares the iterative FFT engine against the recursive dsperado 1.0 one
+// and the packed real input path against widening real input to complex
+int main() {
+  std::mt19937 gen(42);
+  std::normal_distribution<double> dist(0, 1000);
+
+  for (size_t size : {64, 256, 512, 1024, 4096}) {
+    std::vector<Complex> in(size), outNew(size), outOld(size), back(size);
+
+    for (auto& c : in) {
+      c.r = dist(gen);
+      c.i = dist(gen);
+    }
+
+    dsperado::FFTransformer<double, true> fft(size);
+    dsperado::FFTransformer<double, false> ifft(size);
+    legacy::FFTransformer<double, true> fftOld(size);
+
+    fft.transform(in.data(), outNew.data());
+    fftOld.transform(in.data(), outOld.data());
+    ifft.transform(outNew.data(), back.data());
+
+    double maxDiff = 0, maxRoundTrip = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+      maxDiff = std::max(maxDiff, std::hypot(outNew[i].r - outOld[i].r, outNew[i].i - outOld[i].i));
+      maxRoundTrip = std::max(maxRoundTrip, std::hypot(back[i].r - in[i].r, back[i].i - in[i].i));
+    }
+
+    std::printf("N = %zu: max |new - recursive| = %g, max round trip error = %g\n", size, maxDiff, maxRoundTrip);
+
+    const size_t iterations = (1 << 20) / size;
+
+    double oldUs = Bench::measure([&] { fftOld.transform(in.data(), outOld.data()); Bench::keep(outOld[0]); }, iterations);
+    double newUs = Bench::measure([&] { fft.transform(in.data(), outNew.data()); Bench::keep(outNew[0]); }, iterations);
+    double inPlaceUs = Bench::measure([&] { fft.transform(outNew.data(), outNew.data()); Bench::keep(outNew[0]); }, iterations);
+
+    Bench::report("  recursive", oldUs);
+    Bench::report("  iterative", newUs, oldUs);
+    Bench::report("  iterative, in place", inPlaceUs, oldUs);
+
+    // Real input: widening to complex vs half-size packed transform
+    std::vector<double> real(size);
+    std::vector<Complex> widened(size), outReal(size);
+
+    for (size_t i = 0; i < size; ++i) {
+      real[i] = in[i].r;
+      widened[i].r = real[i];
+      widened[i].i = 0;
+    }
+
+    fft.transform(real.data(), outReal.data());
+    fft.transform(widened.data(), outNew.data());
+
+    maxDiff = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+      maxDiff = std::max(maxDiff, std::hypot(outNew[i].r - outReal[i].r, outNew[i].i - outReal[i].i));
+    }
+
+    std::printf("  real input: max |packed - widened| = %g\n", maxDiff);
+
+    double widenedUs = Bench::measure([&] {
+      for (size_t i = 0; i < size; ++i) {
+        widened[i].r = real[i];
+        widened[i].i = 0;
+      }
+      fft.transform(widened.data(), outNew.data());
+      Bench::keep(outNew[0]);
+    }, iterations);
+    double packedUs = Bench::measure([&] { fft.transform(real.data(), outReal.data()); Bench::keep(outReal[0]); }, iterations);
+
+    Bench::report("  real input, widened to complex", widenedUs);
+    Bench::report("  real input, packed half-size", packedUs, widenedUs);
+
+    // Two real inputs in one complex transform
+    std::vector<double> real2(size);
+    std::vector<Complex> outPair1(size), outPair2(size), outReal2(size);
+
+    for (size_t i = 0; i < size; ++i) {
+      real2[i] = in[i].i;
+    }
+
+    fft.transform(real.data(), real2.data(), outPair1.data(), outPair2.data());
+    fft.transform(real2.data(), outReal2.data());
+
+    maxDiff = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+      maxDiff = std::max(maxDiff, std::hypot(outPair1[i].r - outReal[i].r, outPair1[i].i - outReal[i].i));
+      maxDiff = std::max(maxDiff, std::hypot(outPair2[i].r - outReal2[i].r, outPair2[i].i - outReal2[i].i));
+    }
+
+    std::printf("  real pair: max |pair - packed| = %g\n", maxDiff);
+
+    double twoPackedUs = Bench::measure([&] {
+      fft.transform(real.data(), outReal.data());
+      fft.transform(real2.data(), outReal2.data());
+      Bench::keep(outReal2[0]);
+    }, iterations);
+    double pairUs = Bench::measure([&] {
+      fft.transform(real.data(), real2.data(), outPair1.data(), outPair2.data());
+      Bench::keep(outPair2[0]);
+    }, iterations);
+
+    Bench::report("  two real inputs, packed half-size", twoPackedUs);
+    Bench::report("  two real inputs, one complex FFT", pairUs, twoPackedUs);
+  }
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <file_manager.h>
+
+#include "bench.h"
+
+// Former reader: one fread call per sample
+static bool readPerSample(const std::string& fileName, short **rawBeamData, int beams, int vals) {
+  FILE *in = fopen(fileName.c_str(), "rb");
+
+  if (!in) {
+    return false;
+  }
+
+  for (int i = 0; i < beams; ++i) {
+    for (int j = 0; j < vals; ++j) {
+      fread(&rawBeamData[i][j], sizeof(short), 1, in);
+    }
+  }
+
+  fclose(in);
+
+  return true;
+}
+
+// Reading a directory of frames: per-sample fread against per-beam and whole-frame reads.
+// Usage: frame_io_bench [dir [beams vals]], synthetic frames are created if dir has none.
+// Files are read repeatedly, so after the first pass they come from the page cache
+int main(int argc, char **argv) {
+  const std::filesystem::path dir = argc > 1 ? std::filesystem::path(argv[1])
+                                             : std::filesystem::temp_directory_path() / "ust_x_frame_io_bench";
+  const int beams = argc > 3 ? std::atoi(argv[2]) : 161,
+            vals = argc > 3 ? std::atoi(argv[3]) : 512;
+
+  const auto files = Bench::prepareFrames(dir, 64, beams, vals);
+
+  std::vector<short> frame((size_t) beams * vals), rowsData(frame.size());
+  std::vector<short*> rows(beams);
+
+  for (int i = 0; i < beams; ++i) {
+    rows[i] = rowsData.data() + (size_t) i * vals;
+  }
+
+  long long checksums[3] = {0, 0, 0};
+
+  auto sum = [](const std::vector<short>& data) {
+    long long s = 0;
+
+    for (short v : data) {
+      s += v;
+    }
+
+    return s;
+  };
+
+  const double perSampleUs = Bench::measure([&] {
+    for (auto& file : files) {
+      readPerSample(file, rows.data(), beams, vals);
+      checksums[0] += sum(rowsData);
+    }
+  }, 1);
+
+  const double perBeamUs = Bench::measure([&] {
+    for (auto& file : files) {
+      UST::FileManager::readRAWFile(file, rows.data(), beams, vals);
+      checksums[1] += sum(rowsData);
+    }
+  }, 1);
+
+  const double frameUs = Bench::measure([&] {
+    for (auto& file : files) {
+      UST::FileManager::readRAWFrame(file, frame.data(), beams, vals);
+      checksums[2] += sum(frame);
+    }
+  }, 1);
+
+  const double frames = (double) files.size();
+  const double mb = frames * frame.size() * sizeof(short) / (1024.0 * 1024.0);
+
+  std::printf("%zu frames of %dx%d in %s%s\n", files.size(), beams, vals, dir.string().c_str(),
+              checksums[0] == checksums[1] && checksums[1] == checksums[2] ? "" : "  RESULTS DIFFER");
+
+  Bench::report("per sample fread, per frame", perSampleUs / frames);
+  Bench::report("per beam fread (readRAWFile)", perBeamUs / frames, perSampleUs / frames);
+  Bench::report("whole frame (readRAWFrame)", frameUs / frames, perSampleUs / frames);
+
+  std::printf("whole frame throughput: %.1f MB/s\n", mb / (frameUs * 1e-6));
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <frame_source.h>
+
+#include "bench.h"
+
+// Drops the files from the page cache, so that the next pass reads them from the disk
+static void evict(const std::vector<std::string>& files) {
+  for (auto& file : files) {
+    const int fd = open(file.c_str(), O_RDONLY);
+
+    if (fd >= 0) {
+      fdatasync(fd);
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+    }
+  }
+}
+
+static long long sum(const UST::FrameView& view) {
+  long long s = 0;
+
+  for (size_t i = 0; i < view.rows; ++i) {
+    const short *row = view.row(i);
+
+    for (size_t j = 0; j < view.cols; ++j) {
+      s += row[j];
+    }
+  }
+
+  return s;
+}
+
+// Acquiring a directory of frames in order through every frame source, against
+// a plain pread of every file. Usage: frame_source_bench [dir [beams vals [lookahead]]],
+// synthetic frames are created if dir has none. Cached passes read from the page cache,
+// cold passes evict the files first, which needs them to be on a local disk
+int main(int argc, char **argv) {
+  const std::filesystem::path dir = argc > 1 ? std::filesystem::path(argv[1])
+                                             : std::filesystem::temp_directory_path() / "ust_x_frame_source_bench";
+  const int beams = argc > 3 ? std::atoi(argv[2]) : 161,
+            vals = argc > 3 ? std::atoi(argv[3]) : 512;
+  const size_t lookahead = argc > 4 ? (size_t) std::atol(argv[4]) : 8;
+
+  const auto files = Bench::prepareFrames(dir, 256, beams, vals);
+
+  std::vector<short> frame((size_t) beams * vals);
+
+  struct Backend {
+    std::string name;
+    std::function<long long()> pass;
+  };
+
+  std::vector<Backend> backends;
+
+  backends.push_back({"pread", [&]() {
+    long long s = 0;
+
+    for (auto& file : files) {
+      const int fd = open(file.c_str(), O_RDONLY);
+
+      if (fd >= 0) {
+        pread(fd, frame.data(), frame.size() * sizeof(short), 0);
+        close(fd);
+      }
+
+      s += sum({frame.data(), (size_t) vals, (size_t) beams, (size_t) vals});
+    }
+
+    return s;
+  }});
+
+  for (const std::string name : {"read", "mmap", "uring"}) {
+#if !defined(UST_X_HAVE_LIBURING)
+    if (name == "uring") {
+      std::printf("uring: built without liburing, skipped\n");
+      continue;
+    }
+#endif
+
+    backends.push_back({name, [&, name]() {
+      long long s = 0;
+
+      auto source = UST::FrameSource::create(name, files, beams, vals, lookahead);
+      UST::FrameView view;
+
+      for (size_t k = 0; k < source->size(); ++k) {
+        if (source->acquire(k, frame.data(), view)) {
+          s += sum(view);
+          source->release(k);
+        }
+      }
+
+      return s;
+    }});
+  }
+
+  // Best of a few passes, each one after evicting the files if cold is set
+  auto time = [&](const Backend& backend, bool cold, long long& checksum) {
+    double best = 0;
+
+    for (int r = 0; r < 3; ++r) {
+      if (cold) {
+        evict(files);
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      checksum = backend.pass();
+      auto end = std::chrono::steady_clock::now();
+      double us = std::chrono::duration<double, std::micro>(end - start).count();
+
+      if (r == 0 || us < best) {
+        best = us;
+      }
+    }
+
+    return best;
+  };
+
+  const double frames = (double) files.size();
+  const double mb = frames * frame.size() * sizeof(short) / (1024.0 * 1024.0);
+
+  std::printf("%zu frames of %dx%d in %s, lookahead %zu\n", files.size(), beams, vals, dir.string().c_str(), lookahead);
+
+  for (const bool cold : {false, true}) {
+    std::printf("%s:\n", cold ? "cold" : "cached");
+
+    double baselineUs = 0;
+    long long baselineChecksum = 0;
+
+    for (auto& backend : backends) {
+      long long checksum = 0;
+      const double us = time(backend, cold, checksum);
+
+      if (baselineUs == 0) {
+        baselineUs = us;
+        baselineChecksum = checksum;
+      }
+
+      Bench::report(backend.name + (checksum == baselineChecksum ? ", per frame" : ", per frame  RESULTS DIFFER"),
+                    us / frames, baselineUs / frames);
+      std::printf("%-40s %12.1f MB/s\n", "", mb / (us * 1e-6));
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <HilbertTransformer.h>
+
+#include "bench.h"
+#include "legacy/HilbertTransformer.h"
+
+using Complex = dsperado::Complex<double>;
+
+// Textbook analytic signal computed with an O(N^2) long double DFT.
+// dsperado 1.0 additionally zeroed bin N / 2 - 1, legacyMask reproduces that
+static std::vector<Complex> reference(const std::vector<double>& in, bool legacyMask = false) {
+  const size_t n = in.size();
+  std::vector<long double> specR(n), specI(n);
+
+  for (size_t k = 0; k < n; ++k) {
+    long double r = 0, i = 0;
+
+    for (size_t t = 0; t < n; ++t) {
+      long double a = -2.0L * M_PI * (long double) ((k * t) % n) / n;
+      r += in[t] * std::cos(a);
+      i += in[t] * std::sin(a);
+    }
+
+    long double h = (k == 0 || k == n / 2) ? 1 : (k < n / 2 ? 2 : 0);
+
+    if (legacyMask && (k == n / 2 - 1 || k == n / 2)) {
+      h = 0;
+    }
+    specR[k] = r * h;
+    specI[k] = i * h;
+  }
+
+  std::vector<Complex> out(n);
+
+  for (size_t t = 0; t < n; ++t) {
+    long double r = 0, i = 0;
+
+    for (size_t k = 0; k < n; ++k) {
+      long double a = 2.0L * M_PI * (long double) ((k * t) % n) / n;
+      r += specR[k] * std::cos(a) - specI[k] * std::sin(a);
+      i += specR[k] * std::sin(a) + specI[k] * std::cos(a);
+    }
+
+    out[t].r = (double) (r / n);
+    out[t].i = (double) (i / n);
+  }
+
+  return out;
+}
+
+static double maxError(const std::vector<Complex>& a, const std::vector<Complex>& b) {
+  double err = 0;
+
+  for (size_t i = 0; i < a.size(); ++i) {
+    err = std::max(err, std::hypot(a[i].r - b[i].r, a[i].i - b[i].i));
+  }
+
+  return err;
+}
+
+// Accuracy and speed of the fused analytic signal kernels against the dsperado 1.0 Hilbert transformer
+int main() {
+  std::mt19937 gen(7);
+  std::normal_distribution<double> noise(0, 20);
+
+  for (size_t size : {256, 512, 1024}) {
+    // Echo-like signal: modulated carrier with noise, similar to a mean-corrected beam
+    std::vector<double> real(size);
+    std::vector<Complex> complexIn(size);
+    double peak = 0;
+
+    for (size_t t = 0; t < size; ++t) {
+      real[t] = 3000 * std::sin(0.75 * t) * std::exp(-std::pow((t - size / 2.0) / (size / 6.0), 2)) + noise(gen);
+      complexIn[t].r = real[t];
+      complexIn[t].i = 0;
+      peak = std::max(peak, std::fabs(real[t]));
+    }
+
+    const auto ref = reference(real);
+    const auto refLegacyMask = reference(real, true);
+
+    dsperado::HilbertTransformer<double> ht(size);
+    legacy::HilbertTransformer<double> htOld(size);
+
+    std::vector<Complex> outOld(size), outComplex(size), outReal(size);
+
+    htOld.transform(complexIn.data(), outOld.data());
+    ht.transform(complexIn.data(), outComplex.data());
+    ht.transform(real.data(), outReal.data());
+
+    std::printf("N = %zu, signal peak %.1f\n", size, peak);
+    std::printf("  max error vs reference: dsperado 1.0 %g, fused complex %g, fused real %g\n",
+                maxError(outOld, ref), maxError(outComplex, ref), maxError(outReal, ref));
+    std::printf("  max error of dsperado 1.0 vs reference with its own mask: %g\n", maxError(outOld, refLegacyMask));
+    std::printf("  max |fused real - dsperado 1.0| = %g\n", maxError(outReal, outOld));
+
+    const size_t iterations = (1 << 19) / size;
+
+    double oldUs = Bench::measure([&] { htOld.transform(complexIn.data(), outOld.data()); Bench::keep(outOld[0]); }, iterations);
+    double complexUs = Bench::measure([&] { ht.transform(complexIn.data(), outComplex.data()); Bench::keep(outComplex[0]); }, iterations);
+    double realUs = Bench::measure([&] { ht.transform(real.data(), outReal.data()); Bench::keep(outReal[0]); }, iterations);
+
+    Bench::report("  dsperado 1.0", oldUs);
+    Bench::report("  fused, complex input", complexUs, oldUs);
+    Bench::report("  fused, real input", realUs, oldUs);
+
+    // Two beams per transform: the second one is the first one reversed
+    std::vector<double> real2(real.rbegin(), real.rend());
+    std::vector<Complex> outPair1(size), outPair2(size), outSingle2(size);
+
+    ht.transform(real.data(), real2.data(), outPair1.data(), outPair2.data());
+    ht.transform(real2.data(), outSingle2.data());
+
+    std::printf("  two-for-one: max error vs reference %g, max |pair - single| %g\n",
+                maxError(outPair1, ref), maxError(outPair2, outSingle2));
+
+    double singlesUs = Bench::measure([&] {
+      ht.transform(real.data(), outReal.data());
+      ht.transform(real2.data(), outSingle2.data());
+      Bench::keep(outSingle2[0]);
+    }, iterations);
+    double pairUs = Bench::measure([&] {
+      ht.transform(real.data(), real2.data(), outPair1.data(), outPair2.data());
+      Bench::keep(outPair2[0]);
+    }, iterations);
+
+    Bench::report("  two beams, fused real input", singlesUs);
+    Bench::report("  two beams, two-for-one", pairUs, singlesUs);
+  }
+
+  return 0;
+}
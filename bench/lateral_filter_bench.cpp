@@ -0,0 +1,78 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <FIR.h>
+
+#include "bench.h"
+
+// Rows allocated one by one, as the shift fields used to be
+struct Rows {
+  std::vector<std::vector<double>> storage;
+  std::vector<double*> rows;
+
+  Rows(size_t rowsNum, size_t cols) : storage(rowsNum, std::vector<double>(cols)), rows(rowsNum) {
+    for (size_t i = 0; i < rowsNum; ++i) {
+      rows[i] = storage[i].data();
+    }
+  }
+};
+
+// Former loop order: every column in turn, jumping between rows
+static void lowPassColumns(double **out, size_t beams, size_t vals, double alpha) {
+  for (size_t j = 0; j < vals; ++j) {
+    for (size_t i = 1; i < beams; ++i) {
+      out[i][j] = out[i - 1][j] + (alpha * (out[i][j] - out[i - 1][j]));
+    }
+  }
+}
+
+// Lateral low pass filter: column-wise loop against the row-wise dsperado::FIR::lowPass2D
+int main() {
+  std::mt19937 gen(3);
+  std::normal_distribution<double> noise(0, 1);
+
+  const double alpha = 0.0861;
+
+  const size_t sizes[][2] = {{161, 512}, {256, 2048}, {1024, 4096}};
+
+  for (auto& size : sizes) {
+    const size_t beams = size[0], vals = size[1];
+
+    Rows input(beams, vals), columns(beams, vals), rows(beams, vals);
+
+    for (auto& row : input.storage) {
+      for (auto& v : row) {
+        v = noise(gen);
+      }
+    }
+
+    const size_t iterations = std::max((size_t) 1, (size_t) 20000000 / (beams * vals));
+
+    // Filtering is repeated over its own output, the values stay bounded
+    columns.storage = input.storage;
+    const double columnsUs = Bench::measure([&] { lowPassColumns(columns.rows.data(), beams, vals, alpha); },
+                                            iterations);
+
+    rows.storage = input.storage;
+    const double rowsUs = Bench::measure([&] { dsperado::FIR::lowPass2D(rows.rows.data(), beams, 0, vals, alpha); },
+                                         iterations);
+
+    // Same arithmetic in another order, results have to match exactly
+    columns.storage = input.storage;
+    rows.storage = input.storage;
+    lowPassColumns(columns.rows.data(), beams, vals, alpha);
+    dsperado::FIR::lowPass2D(rows.rows.data(), beams, 0, vals, alpha);
+
+    const bool identical = columns.storage == rows.storage;
+
+    const std::string name = std::to_string(beams) + "x" + std::to_string(vals);
+
+    std::printf("%s%s\n", name.c_str(), identical ? "" : "  RESULTS DIFFER");
+    Bench::report("  column by column", columnsUs);
+    Bench::report("  row by row (FIR::lowPass2D)", rowsUs, columnsUs);
+  }
+
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <CpuFeatures.h>
+#include <SplitComplex2D.h>
+#include <XCorr.h>
+#include <XCorrKernels.h>
+
+#include "bench.h"
+
+using Complex = dsperado::Complex<double>;
+using Field = dsperado::SplitComplex2D<double>;
+using Lags = dsperado::XCorr::XCorrLags<double>;
+
+// Correlates every in-bounds window of two fields, as the direct engine path does
+static double sweep(dsperado::XCorr::XCorr3LagsKernel kernel,
+                    const Field& field1, const Field& field2,
+                    size_t windowRows, size_t windowCols, std::vector<Lags>& res) {
+  const size_t rows = field1.rows(), cols = field1.cols();
+  double checksum = 0;
+
+  for (size_t n = 0; n + windowRows <= rows; ++n) {
+    for (size_t m = 0; m + windowCols <= cols; ++m) {
+      Lags& lags = res[n * cols + m];
+
+      lags = Lags{};
+      kernel(field1.tile(n, m, windowRows, windowCols), field2.tile(n, m, windowRows, windowCols), lags);
+      checksum += lags.lag0.r;
+    }
+  }
+
+  return checksum;
+}
+
+// The same sweep over interleaved complex arrays
+static double sweepInterleaved(const std::vector<Complex>& field1, const std::vector<Complex>& field2,
+                               size_t rows, size_t cols, size_t windowRows, size_t windowCols,
+                               std::vector<Lags>& res) {
+  const dsperado::View2D<Complex> view1 = { field1.data(), cols, rows, cols },
+                                  view2 = { field2.data(), cols, rows, cols };
+  double checksum = 0;
+
+  for (size_t n = 0; n + windowRows <= rows; ++n) {
+    for (size_t m = 0; m + windowCols <= cols; ++m) {
+      Lags& lags = res[n * cols + m];
+
+      lags = dsperado::XCorr::XCorr2DComplex3Lags<double>(view1, view2, n, m, windowRows, windowCols);
+      checksum += lags.lag0.r;
+    }
+  }
+
+  return checksum;
+}
+
+static double relDiff(const Complex& a, const Complex& b) {
+  double norm = std::hypot(b.r, b.i);
+  return std::hypot(a.r - b.r, a.i - b.i) / (norm > 0 ? norm : 1);
+}
+
+// Interleaved scalar vs split planes scalar and SIMD window kernels of the three-lag cross correlation
+int main() {
+  const size_t rows = 161, cols = 512;
+
+  std::mt19937 gen(5);
+  std::normal_distribution<double> dist(0, 1000);
+
+  std::vector<Complex> interleaved1(rows * cols), interleaved2(rows * cols);
+  Field field1(rows, cols), field2(rows, cols);
+
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      interleaved1[i * cols + j] = { dist(gen), dist(gen) };
+      interleaved2[i * cols + j] = { dist(gen), dist(gen) };
+      field1.set(i, j, interleaved1[i * cols + j]);
+      field2.set(i, j, interleaved2[i * cols + j]);
+    }
+  }
+
+  const dsperado::SimdLevel host = dsperado::simdLevel();
+  std::printf("Host SIMD level: %s\n", dsperado::simdLevelName(host));
+
+  const size_t windows[][2] = { {26, 4}, {16, 2}, {40, 6}, {64, 8}, {128, 16} };
+  const dsperado::SimdLevel levels[] = { dsperado::SimdLevel::AVX2, dsperado::SimdLevel::AVX512 };
+
+  for (auto& w : windows) {
+    const size_t windowRows = w[1] - w[1] / 2,
+                 windowCols = w[0] - w[0] / 2;
+
+    std::vector<Lags> reference(rows * cols), res(rows * cols);
+    auto scalar = dsperado::XCorr::xCorr3LagsKernel(dsperado::SimdLevel::Scalar);
+
+    std::printf("Window %zu x %zu (axial x lateral)\n", w[0], w[1]);
+
+    double interleavedUs = Bench::measure([&] {
+      Bench::keep(sweepInterleaved(interleaved1, interleaved2, rows, cols, windowRows, windowCols, res));
+    }, 3, 3);
+
+    double scalarUs = Bench::measure([&] {
+      Bench::keep(sweep(scalar, field1, field2, windowRows, windowCols, reference));
+    }, 3, 3);
+
+    Bench::report("  interleaved scalar", interleavedUs);
+    Bench::report("  split scalar", scalarUs, interleavedUs);
+
+    for (auto level : levels) {
+      if (level > host) {
+        continue;
+      }
+
+      auto kernel = dsperado::XCorr::xCorr3LagsKernel(level);
+
+      double us = Bench::measure([&] {
+        Bench::keep(sweep(kernel, field1, field2, windowRows, windowCols, res));
+      }, 3, 3);
+
+      double maxDiff = 0;
+
+      for (size_t n = 0; n + windowRows <= rows; ++n) {
+        for (size_t m = 0; m + windowCols <= cols; ++m) {
+          const size_t k = n * cols + m;
+
+          maxDiff = std::max(maxDiff, relDiff(res[k].lag0, reference[k].lag0));
+          maxDiff = std::max(maxDiff, relDiff(res[k].lagPlus1, reference[k].lagPlus1));
+          maxDiff = std::max(maxDiff, relDiff(res[k].lagMinus1, reference[k].lagMinus1));
+        }
+      }
+
+      Bench::report(std::string("  split ") + dsperado::simdLevelName(level), us, interleavedUs);
+      std::printf("    max relative diff to scalar = %g\n", maxDiff);
+    }
+  }
+
+  return 0;
+}
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include <Complex.h>
+#include <View2D.h>
 
 namespace UST {
     typedef std::vector<std::vector<double>> Field;
@@ -19,6 +20,9 @@ namespace UST {
     typedef std::vector<std::vector<DoublePair>> PairField;
     typedef dsperado::Complex<double> Complex;
 
+    // Raw frame of beams x vals samples, rows may be strided
+    typedef dsperado::View2D<short> FrameView;
+
     struct ICoord {
       int beam = 0;
       int val = 0;
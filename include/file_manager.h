@@ -62,7 +62,14 @@ namespace UST {
       // Close stream
       void closeBinStream();
 
-      // Read RAW data file
+      // RAW data files of dir in natural order of their names, so that "frame_2.raw"
+      // goes before "frame_10.raw"
+      static std::vector<std::filesystem::path> listRAWFiles(const std::string& dir);
+
+      // Read RAW data file, a beam at once. The file has to hold exactly beams x vals samples
       static bool readRAWFile(const std::string& fileName, short **rawBeamData, int beams, int vals);
+
+      // Read RAW data file into a contiguous frame of beams x vals samples at once
+      static bool readRAWFrame(const std::string& fileName, short *frame, int beams, int vals);
     };
 }
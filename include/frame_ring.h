@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace UST {
+    // History of the last depth frames kept in preallocated buffers. A new frame
+    // takes over the buffer of the oldest one, so advancing the history only moves
+    // an index and no frame data is ever copied or reallocated
+    template <class T>
+    class FrameRing {
+    private:
+      struct Entry {
+        size_t frameIndex = 0;
+        bool valid = false;
+        T data;
+      };
+
+      std::vector<Entry> entries;
+
+      // Entry of the newest frame, the next entry is the oldest one
+      size_t newest = 0;
+      size_t count = 0;
+
+      // Position of the entry holding frameIndex, entries.size() if there is none
+      size_t findEntry(size_t frameIndex) const {
+        for (size_t i = 0; i < entries.size(); ++i) {
+          if (entries[i].valid && entries[i].frameIndex == frameIndex) {
+            return i;
+          }
+        }
+
+        return entries.size();
+      }
+
+    public:
+      // makeBuffer() creates the buffer of every entry once
+      template <class MakeBuffer>
+      FrameRing(size_t depth, MakeBuffer makeBuffer) : entries(depth == 0 ? 1 : depth) {
+        for (auto& entry : entries) {
+          entry.data = makeBuffer();
+        }
+
+        newest = entries.size() - 1;
+      }
+
+      size_t depth() const { return entries.size(); }
+
+      // Number of frames held, up to depth
+      size_t size() const { return count; }
+
+      // Buffer to fill with frameIndex: the one already holding it or the buffer
+      // of the oldest frame, which is evicted
+      T& acquire(size_t frameIndex) {
+        const size_t found = findEntry(frameIndex);
+
+        if (found != entries.size()) {
+          return entries[found].data;
+        }
+
+        newest = (newest + 1) % entries.size();
+
+        if (count < entries.size()) {
+          count++;
+        }
+
+        Entry& entry = entries[newest];
+
+        entry.frameIndex = frameIndex;
+        entry.valid = true;
+
+        return entry.data;
+      }
+
+      // Buffer holding frameIndex, nullptr if it is not in the history
+      const T *find(size_t frameIndex) const {
+        const size_t found = findEntry(frameIndex);
+
+        return found != entries.size() ? &entries[found].data : nullptr;
+      }
+
+      // Frame acquired lag frames before the newest one, lag < size()
+      const T& back(size_t lag) const {
+        return entries[(newest + entries.size() - lag) % entries.size()].data;
+      }
+
+      size_t frameIndexBack(size_t lag) const {
+        return entries[(newest + entries.size() - lag) % entries.size()].frameIndex;
+      }
+    };
+}
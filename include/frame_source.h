@@ -0,0 +1,167 @@
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <defines.h>
+
+#if defined(UST_X_HAVE_LIBURING)
+#include <liburing.h>
+#endif
+
+namespace UST {
+    // Supplies raw frames of a series of files as views. A view stays valid until
+    // the frame is released, frames may be acquired and released from different threads
+    class FrameSource {
+    protected:
+      std::vector<std::string> files;
+      int beams, vals;
+
+      // Number of frames after the acquired one to be read ahead
+      size_t lookahead;
+
+    public:
+      // files are the frames to be acquired, in processing order
+      FrameSource(std::vector<std::string> files_, int beams_, int vals_, size_t lookahead_ = 4);
+
+      virtual ~FrameSource() = default;
+
+      size_t size() const { return files.size(); }
+
+      const std::string& fileName(size_t index) const { return files[index]; }
+
+      // Whether acquire copies frames into the caller buffer
+      virtual bool needsBuffer() const = 0;
+
+      // Make frame index available through view. buffer holds beams x vals samples
+      // and is only used if needsBuffer() is true
+      virtual bool acquire(size_t index, short *buffer, FrameView& view) = 0;
+
+      // The view of frame index is no longer used
+      virtual void release(size_t /*index*/) {}
+
+      // "read", "mmap" or "uring", the latter two fall back to "read" where they are
+      // not supported. held is the most frames acquired and not yet released at a time
+      static std::unique_ptr<FrameSource> create(
+        const std::string& backend, std::vector<std::string> files, int beams, int vals,
+        size_t lookahead = 4, size_t held = 1);
+    };
+
+    // Reads every frame into the caller buffer. Where supported, the kernel is asked
+    // to read the files of the next frames into the page cache in the background
+    class ReadFrameSource : public FrameSource {
+    private:
+      // Frames before this one were already advised to be read ahead
+      size_t advised = 0;
+
+    public:
+      using FrameSource::FrameSource;
+
+      bool needsBuffer() const override { return true; }
+
+      bool acquire(size_t index, short *buffer, FrameView& view) override;
+    };
+
+#if defined(__unix__) || defined(__APPLE__)
+    // Maps frame files read-only and hands out views straight into the page cache,
+    // so frames are never copied. Files of the next frames are mapped ahead
+    // with a hint to read them in, so that the kernel reads ahead across files
+    class MappedFrameSource : public FrameSource {
+    private:
+      struct Mapping {
+        void *address = nullptr;
+        size_t length = 0;
+      };
+
+      std::mutex m;
+      std::map<size_t, Mapping> mappings;
+
+      // Map frame index unless it is mapped already, called under the mutex.
+      // Errors are logged if report is true
+      Mapping *map(size_t index, bool report);
+
+    public:
+      using FrameSource::FrameSource;
+
+      ~MappedFrameSource() override;
+
+      bool needsBuffer() const override { return false; }
+
+      bool acquire(size_t index, short *buffer, FrameView& view) override;
+
+      void release(size_t index) override;
+    };
+#endif
+
+#if defined(UST_X_HAVE_LIBURING)
+    // Reads frames with io_uring into buffers registered with the kernel once, so
+    // that a read needs no page pinning. Reads of the next frames are queued together
+    // and submitted with a single system call, keeping many of them in flight
+    class UringFrameSource : public FrameSource {
+    private:
+      enum class SlotState { Free, Reading, Ready, Failed };
+
+      struct Slot {
+        SlotState state = SlotState::Free;
+        int fd = -1;
+
+        // Bytes read so far, a short read is continued
+        size_t done = 0;
+        int error = 0;
+      };
+
+      io_uring ring;
+      bool initialized = false, registered = false;
+
+      size_t frameBytes;
+
+      // A frame per slot: lookahead frames read ahead, held ones and the one being acquired
+      std::vector<short> buffers;
+      std::vector<Slot> slots;
+
+      // Guards slot states, acquire takes ringMutex before it to use the ring
+      std::mutex ringMutex, m;
+      std::condition_variable slotFreed;
+
+      // Slots of frames submitted and not released yet
+      std::map<size_t, size_t> frameSlots;
+
+      // Frames before this one were submitted to be read ahead
+      size_t submitted = 0;
+
+      short *slotData(size_t slot) { return buffers.data() + slot * frameBytes / sizeof(short); }
+
+      // Free slot or slots.size() if there is none, called under m
+      size_t findFreeSlot() const;
+
+      // Queue a read of frame index into slot, which is not free afterwards unless
+      // the file can't be opened. Errors are logged if report is true
+      bool queueRead(size_t index, size_t slot, bool report);
+
+      // Queue the rest of the read of slot after a short read
+      void queueRest(size_t slot);
+
+      // Wait for a read to complete and update its slot. lock holds m, which is
+      // released while waiting. Returns false if waiting failed
+      bool complete(std::unique_lock<std::mutex>& lock);
+
+    public:
+      UringFrameSource(std::vector<std::string> files_, int beams_, int vals_, size_t lookahead_, size_t held);
+
+      ~UringFrameSource() override;
+
+      // Whether the ring could be set up, io_uring may be disabled in the kernel
+      bool isInitialized() const { return initialized; }
+
+      bool needsBuffer() const override { return false; }
+
+      bool acquire(size_t index, short *buffer, FrameView& view) override;
+
+      void release(size_t index) override;
+    };
+#endif
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace UST {
+  namespace Multithreading {
+    // How a thread waits for other threads' work to complete
+    enum class WaitPolicy {
+      // Sleep on a condition variable right away
+      Park,
+      // Spin for a while, then sleep; lowest latency for short waits
+      SpinThenPark,
+      // Run queued pool tasks while there are any, then spin and sleep
+      Help
+    };
+
+    // Hint to the CPU that the thread is spinning
+    inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+      _mm_pause();
+#else
+      std::this_thread::yield();
+#endif
+    }
+
+    // Completion counter: wait() returns once the count drops to zero.
+    // Unlike std::latch, the count may be raised with add() while it is not zero,
+    // so tasks can be registered as they are submitted
+    class Latch {
+    private:
+      std::atomic<size_t> count;
+      std::mutex m;
+      std::condition_variable cond;
+
+    public:
+      // Number of pause iterations before a SpinThenPark waiter sleeps
+      static const size_t defaultSpinCount = 4096;
+
+      explicit Latch(size_t count_ = 0) : count(count_) {}
+
+      Latch(const Latch&) = delete;
+      Latch& operator=(const Latch&) = delete;
+
+      void add(size_t n = 1) {
+        count.fetch_add(n, std::memory_order_relaxed);
+      }
+
+      // The count is lowered under the lock: a waiter which saw zero takes the
+      // lock before returning, so the latch may be destroyed right after wait()
+      void countDown(size_t n = 1) {
+        std::lock_guard<std::mutex> lock(m);
+
+        if (count.fetch_sub(n, std::memory_order_acq_rel) == n) {
+          cond.notify_all();
+        }
+      }
+
+      bool tryWait() const {
+        return count.load(std::memory_order_acquire) == 0;
+      }
+
+      void wait(WaitPolicy policy = WaitPolicy::SpinThenPark, size_t spinCount = defaultSpinCount) {
+        if (policy != WaitPolicy::Park) {
+          for (size_t i = 0; i < spinCount; ++i) {
+            if (tryWait()) {
+              std::lock_guard<std::mutex> lock(m);
+              return;
+            }
+
+            cpuRelax();
+          }
+        }
+
+        std::unique_lock<std::mutex> lock(m);
+
+        cond.wait(lock, [this] { return tryWait(); });
+      }
+    };
+  }
+}
@@ -3,9 +3,12 @@
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <sstream>
 
 namespace UST {
-  // Simple logger class
+  // Simple logger class, may be written to from several threads. Every statement
+  // is written as a whole, so messages of different threads are not interleaved
   class Logger {
   public:
     static Logger& Instance() {
@@ -27,27 +30,48 @@ namespace UST {
       this->enabled = enabled;
     }
 
-    Logger &operator<<(std::ostream& (*pf) (std::ostream&)) {
-      if (enabled) {
-        std::cout << pf;
-        if (enabledFile) {
-          logFile << pf;
+    // Text of one statement, logger << a << b; is written at once when it ends
+    class Message {
+    public:
+      explicit Message(Logger& logger_) : logger(&logger_) {}
+
+      Message(Message&& other) : logger(other.logger), text(std::move(other.text)) {
+        other.logger = nullptr;
+      }
+
+      Message& operator<<(std::ostream& (*pf) (std::ostream&)) {
+        text << pf;
+        return *this;
+      }
+
+      template <typename T>
+      Message& operator<<(const T& info) {
+        text << info;
+        return *this;
+      }
+
+      ~Message() {
+        if (logger) {
+          logger->write(text.str());
         }
       }
-      logFile.flush();
-      return *this;
+
+    private:
+      Logger *logger;
+      std::ostringstream text;
+    };
+
+    Message operator<<(std::ostream& (*pf) (std::ostream&)) {
+      Message message(*this);
+      message << pf;
+      return message;
     }
 
     template <typename T>
-    Logger& operator<<(const T& info) {
-      if (enabled) {
-        std::cout << info;
-        if (enabledFile) {
-          logFile << info;
-        }
-      }
-      logFile.flush();
-      return *this;
+    Message operator<<(const T& info) {
+      Message message(*this);
+      message << info;
+      return message;
     }
 
     Logger(Logger const&) = delete;
@@ -55,10 +79,23 @@ namespace UST {
   private:
     Logger() = default;
 
+    void write(const std::string& text) {
+      std::lock_guard<std::mutex> lock(m);
+
+      if (enabled) {
+        std::cout << text << std::flush;
+        if (enabledFile) {
+          logFile << text;
+        }
+      }
+      logFile.flush();
+    }
+
     ~Logger() {
       logFile.close();
     }
 
+    std::mutex m;
     std::ofstream logFile;
     bool enabled = true;
     bool enabledFile = true;
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace UST {
+  namespace Pipeline {
+    using Clock = std::chrono::steady_clock;
+
+    inline double secondsSince(Clock::time_point start) {
+      return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Blocking FIFO queue of limited capacity between two pipeline stages.
+    // Keeps occupancy statistics: the average and maximum number of queued items
+    // seen by pushes and pops, and the time producers spent blocked on a full queue
+    template <class T>
+    class BoundedQueue {
+    private:
+      std::mutex m;
+      std::condition_variable notEmpty, notFull;
+      std::deque<T> items;
+      size_t capacity;
+      bool closed = false;
+
+      size_t samples = 0, maxOccupancy = 0;
+      double occupancySum = 0, blockedPush = 0;
+
+      void sample() {
+        samples++;
+        occupancySum += items.size();
+
+        if (items.size() > maxOccupancy) {
+          maxOccupancy = items.size();
+        }
+      }
+
+    public:
+      explicit BoundedQueue(size_t capacity_) : capacity(capacity_ == 0 ? 1 : capacity_) {}
+
+      BoundedQueue(const BoundedQueue&) = delete;
+      BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+      // Blocks while the queue is full
+      void push(T item) {
+        std::unique_lock<std::mutex> lock(m);
+
+        if (items.size() >= capacity) {
+          const auto start = Clock::now();
+
+          notFull.wait(lock, [this] { return items.size() < capacity; });
+          blockedPush += secondsSince(start);
+        }
+
+        items.push_back(std::move(item));
+        sample();
+
+        lock.unlock();
+        notEmpty.notify_one();
+      }
+
+      // Blocks while the queue is empty; returns false once it is closed and drained
+      bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m);
+
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+
+        if (items.empty()) {
+          return false;
+        }
+
+        item = std::move(items.front());
+        items.pop_front();
+        sample();
+
+        lock.unlock();
+        notFull.notify_one();
+
+        return true;
+      }
+
+      // No more items will be pushed
+      void close() {
+        {
+          std::lock_guard<std::mutex> lock(m);
+          closed = true;
+        }
+        notEmpty.notify_all();
+      }
+
+      size_t getCapacity() const { return capacity; }
+      size_t getMaxOccupancy() const { return maxOccupancy; }
+      double getAverageOccupancy() const { return samples == 0 ? 0 : occupancySum / samples; }
+      double getBlockedPushTime() const { return blockedPush; }
+    };
+
+    // Time a stage spent processing items and waiting for its input
+    struct StageStats {
+      std::string name;
+      size_t items = 0;
+      double busy = 0, idle = 0;
+    };
+
+    // Starts a thread which pops items from in and passes them to process(item)
+    // until in is closed and drained, then calls finish(). Forwarding items to the
+    // next queue is up to process
+    template <class T, class Process, class Finish>
+    std::thread startStage(StageStats& stats, BoundedQueue<T>& in, Process process, Finish finish) {
+      return std::thread([&stats, &in, process, finish]() mutable {
+        T item;
+
+        for (;;) {
+          auto start = Clock::now();
+
+          if (!in.pop(item)) {
+            break;
+          }
+
+          stats.idle += secondsSince(start);
+
+          start = Clock::now();
+          process(item);
+          stats.busy += secondsSince(start);
+          stats.items++;
+        }
+
+        finish();
+      });
+    }
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <defines.h>
+#include <thread_pool.h>
+
+namespace UST {
+    // Filter chain applied to shift fields before they are accumulated:
+    // median of 3 and low pass along beams, low pass across beams, then
+    // smoothed differentiator along beams
+    class PostProcessor {
+    private:
+      size_t beams, vals;
+
+      // Low pass filters smoothing factor
+      double alpha;
+
+      // Differentiator half-length
+      size_t filterLength;
+
+      // Lateral filter columns handled by one task
+      static const size_t lateralBlock = 64;
+
+      // Multithreading: every pass is split into dynamically claimed chunks,
+      // run on a pool shared with the other processing stages
+      UST::Multithreading::ThreadPool& tp;
+
+      // Differentiator output, a row per task
+      std::vector<double> strain;
+
+      // Median of 3 fused with low pass filter, a single pass over a beam
+      void smoothAxial(double *row) const;
+
+    public:
+      // tp_ has to outlive the post processor
+      PostProcessor(UST::Multithreading::ThreadPool& tp_, size_t beams_, size_t vals_, double alpha_, size_t filterLength_);
+
+      // Filter count shift fields in place and add them to sum in the given order.
+      // After shift k is added, sum is copied to results[k]
+      void process(double ***shifts, Field **results, size_t count, Field& sum);
+    };
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <climits>
+#include <fstream>
+#include <string>
+
+#include <defines.h>
+
+// Sharded processing: a long acquisition is split into contiguous ranges of files,
+// processed independently. As the result is a running sum of per-frame fields,
+// a shard stores its steps accumulated from zero together with the end-of-shard sum,
+// and merging adds the sums of all previous shards to every step
+namespace UST {
+  // Files with numbers [first, last), numbered from 1 in sorted order
+  struct FrameRange {
+    int first = 1;
+    int last = INT_MAX;
+
+    bool contains(int cnt) const {
+      return cnt >= first && cnt < last;
+    }
+
+    bool isFull() const {
+      return first == 1 && last == INT_MAX;
+    }
+
+    // "a:b", "a:" or ":b"
+    static bool parse(const std::string& text, FrameRange& range);
+
+    // Directory name for the partial result of this range
+    std::string name() const;
+  };
+
+  // Writes steps.bin with the step label and field of every step, then sum.bin
+  // with the number of steps and the field after the last step
+  class ShardWriter {
+  private:
+    std::ofstream steps;
+    std::string dir;
+    int beams = 0, vals = 0;
+    int written = 0;
+
+  public:
+    bool open(const std::string& dir_, int beams_, int vals_);
+
+    bool write(int step, const Field& field);
+
+    bool close(const Field& sum);
+  };
+
+  class ShardReader {
+  private:
+    std::ifstream steps;
+    std::string dir;
+    int beams = 0, vals = 0;
+    bool truncated = false;
+
+  public:
+    // Fails if the shard was produced for other data dimensions
+    bool open(const std::string& dir_, int beams_, int vals_);
+
+    // Returns false after the last step or at a truncated step, see isTruncated
+    bool next(int& step, Field& field);
+
+    // Whether next stopped at an incomplete step rather than at the end of steps.bin
+    bool isTruncated() const { return truncated; }
+
+    // stepsNum is the number of steps the shard was closed with
+    bool readSum(Field& sum, int& stepsNum);
+  };
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace UST {
+  namespace Multithreading {
+    // Type-erased void() callable with small buffer optimization.
+    // Trivially copyable callables up to inlineSize bytes (lambdas capturing pointers
+    // and sizes, as the processing tasks do) are stored inline, so creating a task
+    // does not allocate. Other callables are moved to the heap and freed after the run.
+    // Task itself is trivially copyable, so work-stealing deques can copy it word by word
+    class Task {
+    public:
+      static const size_t inlineSize = 64;
+
+    private:
+      using Invoke = void (*)(const Task&);
+
+      Invoke invoke = nullptr;
+      alignas(std::max_align_t) unsigned char storage[inlineSize];
+
+      template <class Function>
+      static void invokeInline(const Task& task) {
+        // A private copy, the stored bytes stay untouched
+        alignas(Function) unsigned char copy[sizeof(Function)];
+
+        std::memcpy(copy, task.storage, sizeof(Function));
+        (*std::launder(reinterpret_cast<Function*>(copy)))();
+      }
+
+      template <class Function>
+      static void invokeHeap(const Task& task) {
+        Function *f;
+
+        std::memcpy(&f, task.storage, sizeof(f));
+        std::unique_ptr<Function> owner(f);
+
+        (*f)();
+      }
+
+    public:
+      Task() = default;
+
+      template <class Function, class F = std::decay_t<Function>,
+                class = std::enable_if_t<!std::is_same<F, Task>::value>>
+      explicit Task(Function&& f) {
+        if constexpr (std::is_trivially_copyable<F>::value && sizeof(F) <= inlineSize &&
+                      alignof(F) <= alignof(std::max_align_t)) {
+          F copy(std::forward<Function>(f));
+
+          std::memcpy(storage, &copy, sizeof(F));
+          invoke = &invokeInline<F>;
+        } else {
+          F *heap = new F(std::forward<Function>(f));
+
+          std::memcpy(storage, &heap, sizeof(heap));
+          invoke = &invokeHeap<F>;
+        }
+      }
+
+      explicit operator bool() const {
+        return invoke != nullptr;
+      }
+
+      // Must be called exactly once per submitted task, as heap callables are freed here
+      void operator()() const {
+        invoke(*this);
+      }
+    };
+
+    static_assert(std::is_trivially_copyable<Task>::value, "Task is copied by work-stealing deques");
+  }
+}
@@ -5,27 +5,146 @@
 #include <vector>
 #include <iostream>
 #include <mutex>
-#include <queue>
+#include <deque>
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+#include <latch.h>
+#include <task.h>
+#include <work_stealing_deque.h>
 
 namespace UST {
   namespace Multithreading {
+    // Chunking of ThreadPool::parallelFor ranges
+    enum class Schedule {
+      // Chunks of grain iterations
+      Dynamic,
+      // Chunks proportional to the remaining iterations, shrinking down to grain
+      Guided
+    };
+
+    // Work-stealing thread pool.
+    // Every worker owns a lock-free deque: tasks submitted from a worker are pushed to
+    // its own deque and popped LIFO, idle workers steal FIFO from the others.
+    // Tasks submitted from other threads are spread round-robin over per-worker inboxes,
+    // so there is no single queue lock all submitters and workers contend on
     class ThreadPool {
     private:
-      bool done;
-      std::condition_variable cond;
+      struct Worker {
+        WorkStealingDeque<Task> deque;
+        std::mutex inboxMutex;
+        std::deque<Task> inbox;
+      };
+
+      // Worker the calling thread belongs to, if any
+      struct Current {
+        ThreadPool *pool = nullptr;
+        size_t index = 0;
+      };
+
+      static Current& current() {
+        thread_local Current c;
+        return c;
+      }
+
+      static const size_t noWorker = (size_t) -1;
+
+      // Failed scans before an idle worker goes to sleep
+      static const size_t idleSpins = 64;
+
       size_t numThreads = 0;
+      std::vector<std::unique_ptr<Worker>> workers;
       std::vector<std::thread> threads;
+
+      std::atomic<bool> done{false};
+      // Tasks submitted and not yet taken, sleeping workers
+      std::atomic<size_t> queued{0}, sleepers{0};
+      std::atomic<size_t> nextInbox{0};
+
       std::mutex m;
-      std::queue<std::function<void()>> tasks;
+      std::condition_variable cond;
 
-      volatile size_t blockSize;
-    public:
-      ThreadPool() {
-        done = false;
+      // Completion of the tasks started with runTask since startTaskBlock
+      Latch block;
+
+      bool takeFromInbox(Worker& worker, Task& task) {
+        std::lock_guard<std::mutex> lock(worker.inboxMutex);
+
+        if (worker.inbox.empty()) {
+          return false;
+        }
+
+        task = worker.inbox.front();
+        worker.inbox.pop_front();
+
+        return true;
+      }
+
+      // Own deque first, then inboxes and other deques starting from the neighbour
+      bool takeTask(Task& task, size_t self) {
+        const size_t start = self == noWorker ? 0 : self;
+        bool found = self != noWorker && workers[self]->deque.pop(task);
+
+        for (size_t k = 0; !found && k < numThreads; ++k) {
+          found = takeFromInbox(*workers[(start + k) % numThreads], task);
+        }
+
+        for (size_t k = 0; !found && k < numThreads; ++k) {
+          const size_t victim = (start + k) % numThreads;
+
+          found = victim != self && workers[victim]->deque.steal(task);
+        }
+
+        if (found) {
+          queued.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        return found;
+      }
+
+      void workerLoop(size_t index) {
+        current() = { this, index };
 
+        for (;;) {
+          Task task;
+          bool found = false;
+
+          for (size_t spin = 0; !found && spin < idleSpins; ++spin) {
+            found = takeTask(task, index);
+
+            if (!found) {
+              cpuRelax();
+            }
+          }
+
+          if (found) {
+            task();
+            continue;
+          }
+
+          std::unique_lock<std::mutex> lock(m);
+
+          sleepers.fetch_add(1);
+          cond.wait(lock, [this] { return done.load() || queued.load() > 0; });
+          sleepers.fetch_sub(1);
+
+          if (done.load() && queued.load() == 0) {
+            return;
+          }
+        }
+      }
+
+    public:
+      // numThreads_ = 0 starts one worker per hardware thread
+      explicit ThreadPool(size_t numThreads_ = 0) : numThreads(numThreads_) {
        // logger << "Starting thread pool...\n";
-        numThreads = std::thread::hardware_concurrency();
+        if (numThreads == 0) {
+          numThreads = std::thread::hardware_concurrency();
+        }
 
         if (numThreads == 0) {
           //logger << "Unable to get hardware concurrency support information. Using 1 thread\n";
@@ -33,62 +152,167 @@ namespace UST {
         }
 
         for (size_t i = 0; i < numThreads; ++i) {
-          threads.emplace_back([&] {
-            for (;;) {
-              std::function<void()> task;
+          workers.emplace_back(new Worker);
+        }
+
+        for (size_t i = 0; i < numThreads; ++i) {
+          threads.emplace_back([this, i] { this->workerLoop(i); });
+        }
+
+        //logger << numThreads << " concurrent threads are supported\n" << SEPARATOR;
+      }
+
+      ThreadPool(const ThreadPool&) = delete;
+      ThreadPool& operator=(const ThreadPool&) = delete;
+
+      // Queue a type-erased task, completion is up to the task itself
+      void submit(const Task& task) {
+        // Counted before it becomes visible, so a worker never sleeps on a queued task
+        queued.fetch_add(1);
+
+        Current& c = current();
+
+        if (c.pool == this) {
+          workers[c.index]->deque.push(task);
+        } else {
+          Worker& worker = *workers[nextInbox.fetch_add(1, std::memory_order_relaxed) % numThreads];
+          std::lock_guard<std::mutex> lock(worker.inboxMutex);
+
+          worker.inbox.push_back(task);
+        }
+
+        if (sleepers.load() > 0) {
+          std::lock_guard<std::mutex> lock(m);
+          cond.notify_one();
+        }
+      }
 
-              {
-                std::unique_lock<std::mutex> lock(this->m);
+      // Queue f() without a result; small trivially copyable callables are not allocated
+      template<class Function>
+      void post(Function&& f) {
+        submit(Task(std::forward<Function>(f)));
+      }
+
+      // Queue f(args...) and get a future for its result. Exceptions thrown by
+      // the task are stored in the future instead of terminating the worker
+      template<class Function, class... Args>
+      auto runTask(Function&& f, Args&&... args) -> std::future<std::invoke_result_t<Function, Args...>> {
+        using Result = std::invoke_result_t<Function, Args...>;
+
+        auto task = std::make_shared<std::packaged_task<Result()>>(
+          std::bind(std::forward<Function>(f), std::forward<Args>(args)...));
+        auto result = task->get_future();
+
+        post([this, task] {
+          (*task)();
+          this->block.countDown();
+        });
+
+        return result;
+      }
+
+      // Threads which may run parallelFor chunks at once: all workers and the caller
+      size_t maxParticipants() const {
+        return numThreads + 1;
+      }
+
+      // Calls fn(chunkBegin, chunkEnd, slot) for chunks covering [begin, end), all
+      // of them a multiple of grain long except the last one. Chunks are claimed
+      // dynamically by the workers and the calling thread, so uneven chunk costs and
+      // counts not divisible by the number of threads do not leave threads idle.
+      // slot is in [0, maxParticipants()) and unique among concurrently running
+      // chunks, e.g. for per-thread scratch buffers. Returns when all chunks are done
+      template<class Function>
+      void parallelFor(size_t begin, size_t end, size_t grain, const Function& fn,
+                       Schedule schedule = Schedule::Guided) {
+        if (begin >= end) {
+          return;
+        }
+
+        grain = std::max(grain, (size_t) 1);
 
-                this->cond.wait(lock, [this] { return this->done || !this->tasks.empty(); });
+        const size_t count = end - begin,
+                     chunks = (count + grain - 1) / grain,
+                     helpers = std::min(numThreads, chunks - 1);
 
-                if (this->done && this->tasks.empty()) {
-                  return;
-                }
+        std::atomic<size_t> next{begin};
 
-                task = std::move(this->tasks.front());
-                this->tasks.pop();
-              }
+        auto runChunks = [&next, &fn, end, grain, schedule, helpers](size_t slot) {
+          size_t chunkBegin = next.load(std::memory_order_relaxed);
 
-              task();
-              {
-                std::unique_lock<std::mutex> lock(this->m);
+          while (chunkBegin < end) {
+            size_t size = grain;
 
-                blockSize--;
-              }
+            if (schedule == Schedule::Guided) {
+              // Remaining work split twice finer than between the participants, in whole grains
+              size = std::max((end - chunkBegin) / (2 * (helpers + 1)) / grain * grain, grain);
+            }
+
+            const size_t chunkEnd = std::min(chunkBegin + size, end);
 
+            if (next.compare_exchange_weak(chunkBegin, chunkEnd, std::memory_order_relaxed)) {
+              fn(chunkBegin, chunkEnd, slot);
+              chunkBegin = chunkEnd;
             }
+          }
+        };
+
+        Latch finished(helpers);
+
+        for (size_t slot = 1; slot <= helpers; ++slot) {
+          post([&runChunks, &finished, slot] {
+            runChunks(slot);
+            finished.countDown();
           });
         }
 
-        //logger << numThreads << " concurrent threads are supported\n" << SEPARATOR;
+        runChunks(0);
+        wait(finished);
       }
 
-      template<class Function, class... Args>
-      void runTask(Function&& f, Args&&... args) {
-        auto task = std::bind(std::forward<Function>(f), std::forward<Args>(args)...);
-        {
-          std::unique_lock<std::mutex> lock(m);
+      // Run one queued task on the calling thread, if there is any
+      bool runPendingTask() {
+        Current& c = current();
+        Task task;
 
-          tasks.emplace(task);
+        if (!takeTask(task, c.pool == this ? c.index : noWorker)) {
+          return false;
         }
-        cond.notify_one();
+
+        task();
+
+        return true;
       }
 
-      // Method for creating barrier by tasks counter e.g. for output
-      void startTaskBlock(size_t size) {
-        {
-          std::unique_lock<std::mutex> lock(m);
-         
-          blockSize = size;
+      // Block until latch is released, helping with queued tasks if asked to
+      void wait(Latch& latch, WaitPolicy policy = WaitPolicy::Help) {
+        if (policy == WaitPolicy::Help) {
+          while (!latch.tryWait() && runPendingTask()) {}
         }
+
+        latch.wait(policy);
       }
 
+      // Method for creating barrier by tasks counter e.g. for output:
+      // every task started with runTask has to be counted here
+      void startTaskBlock(size_t size) {
+        block.add(size);
+      }
+
+      void wait() {
+        wait(block);
+      }
+
+      // Runs the tasks already queued and stops the workers
       void terminate() {
         {
           std::unique_lock<std::mutex> lock(m);
 
-          done = true;
+          if (done.load()) {
+            return;
+          }
+
+          done.store(true);
         }
         cond.notify_all();
 
@@ -97,15 +321,6 @@ namespace UST {
         }
       }
 
-      void wait() {
-        while (blockSize > 0) {}
-        {
-          std::unique_lock<std::mutex> lock(m);
-
-          blockSize = 0;
-        }
-      }
-
       size_t getNumThreads() {
         return numThreads;
       }
@@ -114,5 +329,58 @@ namespace UST {
         terminate();
       }
     };
+
+    // Set of tasks which can be waited for together, independently of other
+    // tasks running on the same pool
+    class TaskGroup {
+    private:
+      ThreadPool& pool;
+      Latch latch;
+      WaitPolicy policy;
+
+    public:
+      explicit TaskGroup(ThreadPool& pool_, WaitPolicy policy_ = WaitPolicy::Help) :
+        pool(pool_), policy(policy_) {}
+
+      TaskGroup(const TaskGroup&) = delete;
+      TaskGroup& operator=(const TaskGroup&) = delete;
+
+      template<class Function, class... Args>
+      auto run(Function&& f, Args&&... args) -> std::future<std::invoke_result_t<Function, Args...>> {
+        using Result = std::invoke_result_t<Function, Args...>;
+
+        auto task = std::make_shared<std::packaged_task<Result()>>(
+          std::bind(std::forward<Function>(f), std::forward<Args>(args)...));
+        auto result = task->get_future();
+
+        latch.add();
+
+        pool.post([this, task] {
+          (*task)();
+          this->latch.countDown();
+        });
+
+        return result;
+      }
+
+      // Queue f() without a result, see ThreadPool::post
+      template<class Function>
+      void spawn(Function&& f) {
+        latch.add();
+
+        pool.post([this, f = std::forward<Function>(f)]() mutable {
+          f();
+          this->latch.countDown();
+        });
+      }
+
+      void wait() {
+        pool.wait(latch, policy);
+      }
+
+      ~TaskGroup() {
+        wait();
+      }
+    };
   }
 }
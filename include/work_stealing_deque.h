@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace UST {
+  namespace Multithreading {
+    // Lock-free Chase-Lev work-stealing deque (Le et al., "Correct and Efficient
+    // Work-Stealing for Weak Memory Models", 2013).
+    // The owner thread pushes and pops at the bottom, any thread may steal from the top.
+    // Elements are trivially copyable and kept in atomic words, so a steal racing with
+    // a wrap-around overwrite is not a data race; its CAS on top fails and it retries
+    template <class T>
+    class WorkStealingDeque {
+      static_assert(std::is_trivially_copyable<T>::value && sizeof(T) % sizeof(uint64_t) == 0,
+                    "Deque elements are copied word by word");
+
+    private:
+      static const size_t words = sizeof(T) / sizeof(uint64_t);
+
+      struct Slot {
+        std::atomic<uint64_t> word[words];
+      };
+
+      struct Buffer {
+        int64_t capacity;
+        std::unique_ptr<Slot[]> slots;
+
+        explicit Buffer(int64_t capacity_) : capacity(capacity_), slots(new Slot[capacity_]) {}
+
+        void put(int64_t i, const T& value) {
+          uint64_t raw[words];
+          std::memcpy(raw, &value, sizeof(T));
+
+          Slot& slot = slots[i & (capacity - 1)];
+
+          for (size_t w = 0; w < words; ++w) {
+            slot.word[w].store(raw[w], std::memory_order_relaxed);
+          }
+        }
+
+        T get(int64_t i) const {
+          uint64_t raw[words];
+          const Slot& slot = slots[i & (capacity - 1)];
+
+          for (size_t w = 0; w < words; ++w) {
+            raw[w] = slot.word[w].load(std::memory_order_relaxed);
+          }
+
+          T value;
+          std::memcpy(&value, raw, sizeof(T));
+
+          return value;
+        }
+      };
+
+      alignas(64) std::atomic<int64_t> top{0};
+      alignas(64) std::atomic<int64_t> bottom{0};
+      std::atomic<Buffer*> buffer;
+
+      // Buffers replaced on growth, stealers may still read them; owned by the owner thread
+      std::vector<std::unique_ptr<Buffer>> buffers;
+
+      Buffer *grow(Buffer *old, int64_t t, int64_t b) {
+        buffers.emplace_back(new Buffer(old->capacity * 2));
+        Buffer *bigger = buffers.back().get();
+
+        for (int64_t i = t; i < b; ++i) {
+          bigger->put(i, old->get(i));
+        }
+
+        buffer.store(bigger, std::memory_order_release);
+
+        return bigger;
+      }
+
+    public:
+      // capacity is rounded up to a power of two
+      explicit WorkStealingDeque(size_t capacity = 256) {
+        int64_t size = 1;
+
+        while ((size_t) size < capacity) {
+          size *= 2;
+        }
+
+        buffers.emplace_back(new Buffer(size));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+      }
+
+      WorkStealingDeque(const WorkStealingDeque&) = delete;
+      WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+      // Owner only
+      void push(const T& value) {
+        const int64_t b = bottom.load(std::memory_order_relaxed),
+                      t = top.load(std::memory_order_acquire);
+        Buffer *a = buffer.load(std::memory_order_relaxed);
+
+        if (b - t > a->capacity - 1) {
+          a = grow(a, t, b);
+        }
+
+        a->put(b, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+      }
+
+      // Owner only, LIFO end
+      bool pop(T& value) {
+        const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer *a = buffer.load(std::memory_order_relaxed);
+
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+          bottom.store(b + 1, std::memory_order_relaxed);
+          return false;
+        }
+
+        value = a->get(b);
+
+        if (t == b) {
+          // The last element, race against stealers
+          const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                       std::memory_order_relaxed);
+
+          bottom.store(b + 1, std::memory_order_relaxed);
+
+          return won;
+        }
+
+        return true;
+      }
+
+      // Any thread, FIFO end. May fail spuriously when racing with other thieves
+      bool steal(T& value) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) {
+          return false;
+        }
+
+        Buffer *a = buffer.load(std::memory_order_acquire);
+        value = a->get(t);
+
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                           std::memory_order_relaxed);
+      }
+
+      bool empty() const {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+      }
+    };
+  }
+}
@@ -2,46 +2,120 @@
 
 #include <defines.h>
 #include <thread_pool.h>
+#include <frame_ring.h>
+
+#include <SplitComplex2D.h>
+
+#include <vector>
 
 namespace UST {
+    // Cross correlation method
+    enum class XCorrMethod {
+      // Correlate copied windows for every output sample
+      Direct,
+      // Read window sums from summed-area tables of lagged products
+      SummedArea
+    };
+
     class XCorrEngine {
     private:
-      // Windows for XCorrelation
-      UST::Complex ***windows;
+      // Analytic fields are stored as separate real and imaginary planes
+      typedef dsperado::SplitComplex2D<double> SplitField;
+
+      // Windows for XCorrelation near the field borders, two per task stacked vertically
+      SplitField windows;
 
-      // Outputs for Hilbert transform
-      UST::Complex **hField1, **hField2;
+      // Outputs for Hilbert transform: a small ring of analytic fields
+      // keyed by frame index, so every frame is transformed only once
+      FrameRing<SplitField> hFields;
 
       // Data and window sizes
       size_t window_size_lateral, window_size_axial;
       int window_size_by_2_lateral, window_size_by_2_axial;
       size_t size1, size2;
 
-      // Multithreading tasks set up
-      UST::Multithreading::ThreadPool tp;
-      size_t numThreads = tp.getNumThreads();
-      size_t pieceSize = size1 / numThreads;
-      size_t div = size1 % numThreads;
-      size_t numTasks = numThreads + (div == 0 ? 0 : 1);
+      // Part of the window actually correlated: beams [n, n + windowRows)
+      // and samples [m, m + windowCols) for output sample (n, m)
+      size_t windowRows, windowCols;
+
+      XCorrMethod method;
+
+      // Direct method output is computed in tiles of tileRows beams x tileCols samples
+      size_t tileRows = 0, tileCols = 0;
+
+      // Summed-area tables for lags 0, 1 and -1 (SummedArea method only).
+      // Each one has satRows x satPitch elements with zero first row and column,
+      // and covers the fields extended by clamping up to the farthest window
+      std::vector<UST::Complex> sat[3];
+      size_t satRows = 0, satPitch = 0;
+
+      // Multithreading: stages are split into dynamically claimed chunks,
+      // run on a pool shared with the other processing stages
+      UST::Multithreading::ThreadPool& tp;
 
       void hilbertTask(
-        short **sig1,
-        short **sig2,
+        const FrameView& sig,
+        SplitField& hField,
         size_t begin,
         size_t end);
 
       void xCorrTask(
+        const SplitField& hField1,
+        const SplitField& hField2,
+        double **out,
+        size_t rowBegin,
+        size_t rowEnd,
+        size_t colBegin,
+        size_t colEnd,
+        size_t slot);
+
+      void satRowsTask(
+        const SplitField& hField1,
+        const SplitField& hField2,
+        size_t begin,
+        size_t end);
+
+      void satColumnsTask(
+        size_t begin,
+        size_t end);
+
+      void satXCorrTask(
+        double **out,
         size_t begin,
-        size_t end,
-        size_t taskId);
+        size_t end);
 
-      double **out;
+      const SplitField *findHField(size_t frameIndex) const;
+
+      // Pick the largest tile whose window rows of both fields fit into half of L2,
+      // then shrink it until there are enough tiles to balance the threads
+      void autoTile();
 
     public:
-      XCorrEngine(size_t window_size_axial_, size_t window_size_lateral_, size_t size1_, size_t size2_);
+      // historySize is the number of analytic fields kept at once, tp_ has to outlive the engine
+      XCorrEngine(UST::Multithreading::ThreadPool& tp_,
+                  size_t window_size_axial_, size_t window_size_lateral_, size_t size1_, size_t size2_,
+                  size_t historySize = 2, XCorrMethod method_ = XCorrMethod::Direct);
+
+      // Hilbert transform a frame and keep its analytic field under frameIndex,
+      // evicting the oldest one added
+      void addFrame(size_t frameIndex, const FrameView& sig);
+
+      // Hilbert transform count frames at once, like addFrame for each of them in order.
+      // The history has to be large enough to keep the frames still needed
+      void addFrames(const size_t *frameIndices, const FrameView *sigs, size_t count);
+
+      // Calculate shift between two previously added frames. Every element of out
+      // is overwritten, samples too close to the transducer are set to zero
+      bool calcShift(size_t frameIndex1, size_t frameIndex2, double **out);
+
+      // Calculate shifts for count frame pairs at once: outs[k] receives the shift
+      // between frameIndices1[k] and frameIndices2[k]
+      bool calcShifts(const size_t *frameIndices1, const size_t *frameIndices2, double ***outs, size_t count);
 
-      void calcShift(short **sig1, short **sig2, double **out);
+      // Set the direct method tile size, 0 in either dimension selects it automatically
+      void setTile(size_t beams, size_t samples);
 
-      ~XCorrEngine();
+      size_t getTileBeams() const { return tileRows; }
+      size_t getTileSamples() const { return tileCols; }
     };
 }
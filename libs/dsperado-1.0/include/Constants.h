@@ -4,5 +4,6 @@
 
 namespace dsperado {
     static constexpr double oneDivPI2 = 1.0 / M_PI_2;
+    static constexpr double PI = M_PI;
     static constexpr double PI2 = 2 * M_PI;
 }
\ No newline at end of file
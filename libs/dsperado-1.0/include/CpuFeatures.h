@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define DSPERADO_X86 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// Compiles a single function for the given instruction set, so that SIMD paths live
+// in the same binary as the portable ones and are only called after runtime detection
+#if defined(DSPERADO_X86) && (defined(__GNUC__) || defined(__clang__))
+#define DSPERADO_TARGET(isa) __attribute__((target(isa)))
+#else
+#define DSPERADO_TARGET(isa)
+#endif
+
+namespace dsperado {
+    /*
+     * Instruction set levels with dedicated code paths, in ascending order.
+     */
+    enum class SimdLevel {
+        Scalar,
+        AVX2,    // AVX2 + FMA
+        AVX512   // AVX-512F
+    };
+
+    namespace detail {
+        inline SimdLevel detectSimdLevel() {
+#if defined(DSPERADO_X86) && (defined(__GNUC__) || defined(__clang__))
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("avx512f")) {
+                return SimdLevel::AVX512;
+            }
+
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                return SimdLevel::AVX2;
+            }
+#elif defined(DSPERADO_X86) && defined(_MSC_VER)
+            int info[4];
+
+            __cpuid(info, 0);
+
+            if (info[0] < 7) {
+                return SimdLevel::Scalar;
+            }
+
+            __cpuid(info, 1);
+
+            const bool osxsave = (info[2] & (1 << 27)) != 0,
+                       fma = (info[2] & (1 << 12)) != 0;
+
+            if (!osxsave) {
+                return SimdLevel::Scalar;
+            }
+
+            // The OS has to preserve YMM (and for AVX-512 also opmask and ZMM) state
+            const unsigned long long xcr0 = _xgetbv(0);
+
+            __cpuidex(info, 7, 0);
+
+            if ((xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16))) {
+                return SimdLevel::AVX512;
+            }
+
+            if ((xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) && fma) {
+                return SimdLevel::AVX2;
+            }
+#endif
+            return SimdLevel::Scalar;
+        }
+    }
+
+    /*
+     * Returns the highest SIMD level supported by the host, detected once.
+     * DSPERADO_SIMD environment variable (scalar, avx2, avx512) can lower it,
+     *   which is useful to compare code paths within one binary.
+     */
+    inline SimdLevel simdLevel() {
+        static const SimdLevel level = [] {
+            SimdLevel detected = detail::detectSimdLevel();
+            const char *cap = std::getenv("DSPERADO_SIMD");
+
+            if (cap != nullptr) {
+                SimdLevel requested = detected;
+
+                if (std::strcmp(cap, "scalar") == 0) {
+                    requested = SimdLevel::Scalar;
+                } else if (std::strcmp(cap, "avx2") == 0) {
+                    requested = SimdLevel::AVX2;
+                }
+
+                if (requested < detected) {
+                    detected = requested;
+                }
+            }
+
+            return detected;
+        }();
+
+        return level;
+    }
+
+    inline const char *simdLevelName(const SimdLevel level) {
+        switch (level) {
+            case SimdLevel::AVX2:
+                return "avx2";
+            case SimdLevel::AVX512:
+                return "avx512";
+            default:
+                return "scalar";
+        }
+    }
+
+    /*
+     * Returns the size of the per-core L2 cache in bytes, detected once.
+     * Falls back to defaultSize if the platform does not report it.
+     */
+    inline size_t cacheSizeL2(size_t defaultSize = 1 << 20) {
+        static const size_t detected = [] {
+            long size = 0;
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+            size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+#if defined(__linux__)
+            if (size <= 0) {
+                if (FILE *f = std::fopen("/sys/devices/system/cpu/cpu0/cache/index2/size", "r")) {
+                    char unit = 0;
+
+                    if (std::fscanf(f, "%ld%c", &size, &unit) >= 1 && (unit == 'K' || unit == 'k')) {
+                        size *= 1024;
+                    }
+
+                    std::fclose(f);
+                }
+            }
+#endif
+            return size > 0 ? (size_t) size : (size_t) 0;
+        }();
+
+        return detected != 0 ? detected : defaultSize;
+    }
+}
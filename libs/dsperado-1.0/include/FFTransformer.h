@@ -5,15 +5,17 @@
 #include <cmath>
 #include <memory>
 #include <type_traits>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <Complex.h>
-#include <Arena.h>
 #include <Constants.h>
 
 namespace dsperado {
     /*
      * Fast Fourier Transformer class.
+     * Iterative in-place radix-2 implementation: bit-reversal permutation and
+     *   twiddle factors are precomputed once per transformer size.
      * Intended to be used if multiple one-size transformations are needed.
      * The first template argument is the desired Complex base type.
      * The second template argument is the FFT direction flag (true - FFT, false - IFFT).
@@ -24,16 +26,21 @@ namespace dsperado {
         using Type = dsperado::Complex<T>;
 
         size_t size;
-        std::shared_ptr<dsperado::Arena<Type>> arena;
-        size_t ind1, ind2;
-        Type w, *wn, *tmp0, *tmp1, *tmp2, *tmp3;
-        T ang;
-        T tmpReal0, tmpReal1;
-        Type *complexIn;
 
-        std::unordered_map<size_t, Type> coeffs;
+        // Input index for every output position
+        std::vector<size_t> bitReversed;
 
-        bool complexInAllocated = false;
+        // Twiddle factors grouped by stage: the stage with half-length h
+        //   keeps its h factors contiguously starting at offset h - 1
+        std::vector<Type> twiddles;
+
+        // Half-size transformer and its buffer for real input packing,
+        //   created on the first real transform
+        std::unique_ptr<FFTransformer<T, forward>> halfTransformer;
+        std::vector<Type> packed;
+
+        // Buffer for the two real inputs transform, allocated on first use
+        std::vector<Type> pairBuffer;
 
         /*
          * These are the helper methods for compile time check if FFT is inversed
@@ -48,59 +55,95 @@ namespace dsperado {
             return PI2 / n;
         }
 
-        template <bool f>
-        inline void divBy2(typename std::enable_if<f, Type*>::type c) {}
-
-        template <bool f>
-        inline void divBy2(typename std::enable_if<!f, Type*>::type c) {
-            c->r /= 2;
-            c->i /= 2;
-        }
-
-        void fft(const Type* in, Type* out, size_t n) {
-            if (n == 1) {
-                return;
+        /*
+         * Reorders input into bit-reversed order, in place if in == out.
+         */
+        void permute(const Type* in, Type* out) {
+            size_t ind1, ind2;
+
+            if (in == out) {
+                for (ind1 = 0; ind1 < size; ++ind1) {
+                    ind2 = bitReversed[ind1];
+
+                    if (ind1 < ind2) {
+                        std::swap(out[ind1], out[ind2]);
+                    }
+                }
+            } else {
+                for (ind1 = 0; ind1 < size; ++ind1) {
+                    out[ind1] = in[bitReversed[ind1]];
+                }
             }
+        }
 
-            const size_t n_d2 = n / 2;
-
-            auto *s0 = this->arena->allocate(n_d2);
-            auto *s1 = this->arena->allocate(n_d2);
-
-            for (ind1 = 0, ind2 = 0; ind1 < n; ind1 += 2, ++ind2) {
-                s0[ind2] = in[ind1];
-                s1[ind2] = in[ind1 + 1];
+        /*
+         * Runs butterfly stages with half-length in [beginHalf, endHalf) over bit-reversed data.
+         */
+        void butterflies(Type* data, size_t beginHalf, size_t endHalf) {
+            size_t start, ind;
+            Type a, b;
+            const Type *w;
+
+            // Twiddle of the first stage is 1
+            if (beginHalf == 1 && endHalf > 1) {
+                for (start = 0; start < size; start += 2) {
+                    a = data[start];
+                    b = data[start + 1];
+
+                    data[start].r = a.r + b.r;
+                    data[start].i = a.i + b.i;
+                    data[start + 1].r = a.r - b.r;
+                    data[start + 1].i = a.i - b.i;
+                }
             }
 
-            fft(s0, s0, n_d2);
-            fft(s1, s1, n_d2);
+            for (size_t half = beginHalf > 2 ? beginHalf : 2; half < endHalf; half *= 2) {
+                w = &twiddles[half - 1];
 
-            w.r = 1;
-            w.i = 0;
+                for (start = 0; start < size; start += 2 * half) {
+                    Type *lo = data + start;
+                    Type *hi = lo + half;
 
-            wn = &coeffs[n];
+                    for (ind = 0; ind < half; ++ind) {
+                        b.r = w[ind].r * hi[ind].r - w[ind].i * hi[ind].i;
+                        b.i = w[ind].r * hi[ind].i + w[ind].i * hi[ind].r;
 
-            for (ind1 = 0; ind1 < n_d2; ++ind1) {
-                tmp0 = &s0[ind1];
-                tmp1 = &s1[ind1];
-                tmp2 = &out[ind1];
-                tmp3 = &out[ind1 + n_d2];
-
-                tmpReal0 = w.r * tmp1->r - w.i * tmp1->i;
-                tmpReal1 = w.r * tmp1->i + w.i * tmp1->r;
-
-                tmp2->r = tmp0->r + tmpReal0;
-                tmp2->i = tmp0->i + tmpReal1;
-
-                tmp3->r = tmp0->r - tmpReal0;
-                tmp3->i = tmp0->i - tmpReal1;
+                        hi[ind].r = lo[ind].r - b.r;
+                        hi[ind].i = lo[ind].i - b.i;
+                        lo[ind].r += b.r;
+                        lo[ind].i += b.i;
+                    }
+                }
+            }
+        }
 
-                divBy2<forward>(tmp2);
-                divBy2<forward>(tmp3);
+        /*
+         * Last butterfly stage (half-length size / 2). IFFT normalization is applied here.
+         */
+        void lastStage(Type* data) {
+            const size_t half = size / 2;
+            const Type *w = &twiddles[half - 1];
+            const T scale = forward ? T(1) : T(1) / size;
+
+            Type *lo = data;
+            Type *hi = data + half;
+            Type b;
+
+            for (size_t ind = 0; ind < half; ++ind) {
+                b.r = w[ind].r * hi[ind].r - w[ind].i * hi[ind].i;
+                b.i = w[ind].r * hi[ind].i + w[ind].i * hi[ind].r;
+
+                hi[ind].r = (lo[ind].r - b.r) * scale;
+                hi[ind].i = (lo[ind].i - b.i) * scale;
+                lo[ind].r = (lo[ind].r + b.r) * scale;
+                lo[ind].i = (lo[ind].i + b.i) * scale;
+            }
+        }
 
-                tmpReal0 = w.r;
-                w.r = w.r * wn->r - w.i * wn->i;
-                w.i = tmpReal0 * wn->i + w.i * wn->r;
+        void allocateHalf() {
+            if (!halfTransformer) {
+                halfTransformer = std::make_unique<FFTransformer<T, forward>>(this->size / 2);
+                packed.resize(this->size / 2);
             }
         }
 
@@ -111,60 +154,308 @@ namespace dsperado {
          *   size_ - size of the transformer, restricted to be power of 2
          */
         FFTransformer(size_t size_) : size(size_) {
-            assert((size_ & (size_ - 1)) == 0);
+            assert(size_ != 0 && (size_ & (size_ - 1)) == 0);
+
+            size_t sizeLog = 0;
+
+            while (((size_t) 1 << sizeLog) < size_) {
+                ++sizeLog;
+            }
 
-            auto sizeLog = (size_t) log2(size_);
+            bitReversed.resize(size_);
 
-            this->arena = std::make_shared<dsperado::Arena<Type>>(size_ * sizeLog);
+            for (size_t i = 0; i < size_; ++i) {
+                size_t rev = 0;
+
+                for (size_t bit = 0; bit < sizeLog; ++bit) {
+                    rev |= ((i >> bit) & 1) << (sizeLog - 1 - bit);
+                }
+
+                bitReversed[i] = rev;
+            }
 
-            coeffs.reserve(sizeLog);
+            twiddles.resize(size_ > 1 ? size_ - 1 : 0);
 
-            Type wn;
+            for (size_t half = 1; half < size_; half *= 2) {
+                auto angle = calcCoeff<forward>(2 * half);
 
-            for (size_t i = 1; i <= sizeLog; ++i) {
-              auto n = pow(2, i);
-              auto angle = calcCoeff<forward>(n);
-              wn.r = cos(angle);
-              wn.i = sin(angle);
-              coeffs[n] = wn;
+                for (size_t i = 0; i < half; ++i) {
+                    twiddles[half - 1 + i].r = (T) cos(angle * i);
+                    twiddles[half - 1 + i].i = (T) sin(angle * i);
+                }
             }
         }
 
+        FFTransformer(const FFTransformer&) = delete;
+        FFTransformer& operator=(const FFTransformer&) = delete;
+
         /*
          * Performs FFT (complex -> complex).
          * Params:
          *   in - pointer to the input Complex<T> number array
-         *   out - pointer to the output Complex<T> number array
+         *   out - pointer to the output Complex<T> number array, may be equal to in
          */
         void transform(const Type* in, Type* out) {
-            this->arena->reset();
-            this->fft(in, out, this->size);
+            this->permute(in, out);
+
+            if (this->size < 2) {
+                return;
+            }
+
+            this->butterflies(out, 1, this->size / 2);
+            this->lastStage(out);
+        }
+
+        /*
+         * Performs FFT (real -> complex) via half-size complex transform.
+         * Even samples are packed into real parts and odd samples into
+         *   imaginary parts, then the spectrum is split back in one pass.
+         * Params:
+         *   in - pointer to the input T number array
+         *   store - callable store(k, X[k]), called for every k in [0, size / 2]
+         */
+        template <typename Store>
+        void transformReal(const T* in, Store&& store) {
+            if (this->size == 1) {
+                store(0, Type{in[0], 0});
+                return;
+            }
+
+            const size_t half = this->size / 2;
+
+            this->allocateHalf();
+
+            for (size_t ind = 0; ind < half; ++ind) {
+                packed[ind].r = in[2 * ind];
+                packed[ind].i = in[2 * ind + 1];
+            }
+
+            halfTransformer->transform(packed.data(), packed.data());
+
+            // Inverse half transform is normalized by 2 / size, not 1 / size
+            const T scale = forward ? T(0.5) : T(0.25);
+            const Type *w = &twiddles[half - 1];
+            const Type *z = packed.data();
+            Type e, o, x;
+
+            // Bins 0 and size / 2 are both built from z[0]
+            x.r = 2 * scale * (z[0].r + z[0].i);
+            x.i = 0;
+            store(0, x);
+
+            for (size_t k = 1; k < half; ++k) {
+                const Type& zk = z[k];
+                const Type& zc = z[half - k];
+
+                // Even and odd sample spectra (scaled by 2)
+                e.r = zk.r + zc.r;
+                e.i = zk.i - zc.i;
+                o.r = zk.i + zc.i;
+                o.i = zc.r - zk.r;
+
+                x.r = (e.r + w[k].r * o.r - w[k].i * o.i) * scale;
+                x.i = (e.i + w[k].r * o.i + w[k].i * o.r) * scale;
+
+                store(k, x);
+            }
+
+            x.r = 2 * scale * (z[0].r - z[0].i);
+            x.i = 0;
+            store(half, x);
         }
 
         /*
          * Perform FFT (real -> complex).
+         * Uses a half-size complex transform, the upper half of the spectrum
+         *   is filled from conjugate symmetry.
          * Params:
          *   in - pointer to the input T number array
          *   out - pointer to the output Complex<T> number array
          */
         void transform(const T* in, Type* out) {
-            if (!complexInAllocated) {
-                complexIn = new Type[size];
-                complexInAllocated = true;
+            const size_t n = this->size;
+
+            this->transformReal(in, [out, n](size_t k, const Type& x) {
+                out[k] = x;
+                out[(n - k) & (n - 1)].r = x.r;
+                out[(n - k) & (n - 1)].i = -x.i;
+            });
+        }
+
+        /*
+         * Perform FFT (real -> complex) producing only the non-redundant half
+         *   of the spectrum.
+         * Params:
+         *   in - pointer to the input T number array
+         *   out - pointer to the output Complex<T> number array of size / 2 + 1 elements
+         */
+        void transformHalf(const T* in, Type* out) {
+            this->transformReal(in, [out](size_t k, const Type& x) {
+                out[k] = x;
+            });
+        }
+
+        /*
+         * Perform two FFTs (real -> complex) with a single complex transform.
+         * in1 is packed into real parts and in2 into imaginary parts, then both
+         *   spectra are separated using conjugate symmetry.
+         * Params:
+         *   in1, in2 - pointers to the input T number arrays
+         *   out1, out2 - pointers to the output Complex<T> number arrays
+         */
+        void transform(const T* in1, const T* in2, Type* out1, Type* out2) {
+            const size_t n = this->size;
+
+            if (pairBuffer.size() != n) {
+                pairBuffer.resize(n);
+            }
+
+            Type *z = pairBuffer.data();
+
+            for (size_t ind = 0; ind < n; ++ind) {
+                z[ind].r = in1[ind];
+                z[ind].i = in2[ind];
+            }
+
+            this->transform(z, z);
+
+            // X1[k] = (Z[k] + conj(Z[n - k])) / 2, X2[k] = (Z[k] - conj(Z[n - k])) / 2i
+            for (size_t k = 0; k <= n / 2; ++k) {
+                const Type zk = z[k];
+                const Type zc = z[(n - k) & (n - 1)];
+
+                out1[k].r = (zk.r + zc.r) / 2;
+                out1[k].i = (zk.i - zc.i) / 2;
+                out2[k].r = (zk.i + zc.i) / 2;
+                out2[k].i = (zc.r - zk.r) / 2;
+
+                out1[(n - k) & (n - 1)].r = out1[k].r;
+                out1[(n - k) & (n - 1)].i = -out1[k].i;
+                out2[(n - k) & (n - 1)].r = out2[k].r;
+                out2[(n - k) & (n - 1)].i = -out2[k].i;
+            }
+        }
+
+        /*
+         * Performs FFT (complex -> complex) producing the analytic signal spectrum:
+         *   bins 1 .. size / 2 - 1 are doubled, bins 0 and size / 2 are kept and the
+         *   rest are zero. Scaling and masking are fused into the last butterfly stage.
+         * Params:
+         *   in - pointer to the input Complex<T> number array
+         *   out - pointer to the output Complex<T> number array, may be equal to in.
+         *     Only bins 0 .. size / 2 are valid on return, the upper half is
+         *     left unspecified instead of being zeroed
+         */
+        void analyticSpectrum(const Type* in, Type* out) {
+            static_assert(forward, "Analytic spectrum is only defined for the forward transform");
+
+            this->permute(in, out);
+
+            if (this->size < 2) {
+                return;
+            }
+
+            const size_t half = this->size / 2;
+
+            this->butterflies(out, 1, half);
+
+            const Type *w = &twiddles[half - 1];
+            Type *lo = out;
+            Type *hi = out + half;
+            Type b = hi[0];
+
+            hi[0].r = lo[0].r - b.r;
+            hi[0].i = lo[0].i - b.i;
+            lo[0].r += b.r;
+            lo[0].i += b.i;
+
+            for (size_t ind = 1; ind < half; ++ind) {
+                b.r = w[ind].r * hi[ind].r - w[ind].i * hi[ind].i;
+                b.i = w[ind].r * hi[ind].i + w[ind].i * hi[ind].r;
+
+                lo[ind].r = 2 * (lo[ind].r + b.r);
+                lo[ind].i = 2 * (lo[ind].i + b.i);
             }
+        }
+
+        /*
+         * Performs FFT (complex -> complex) of a spectrum the upper half of which is zero,
+         *   e.g. the one produced by analyticSpectrum. The first butterfly stage reduces
+         *   to copying and is merged into the bit-reversal permutation.
+         * Params:
+         *   in - pointer to the input Complex<T> number array, only bins 0 .. size / 2 are read
+         *   out - pointer to the output Complex<T> number array, must not be equal to in
+         */
+        void transformLowerHalf(const Type* in, Type* out) {
+            assert(in != out);
+
+            if (this->size <= 2) {
+                this->transform(in, out);
+                return;
+            }
+
+            const size_t half = this->size / 2;
+
+            // Pairs of the first stage are in[k] and in[k + half], the latter being zero unless k = 0
+            out[0].r = in[0].r + in[half].r;
+            out[0].i = in[0].i + in[half].i;
+            out[1].r = in[0].r - in[half].r;
+            out[1].i = in[0].i - in[half].i;
 
-            for (ind1 = 0; ind1 < size; ++ind1) {
-                complexIn[ind1].r = in[ind1];
-                complexIn[ind1].i = 0;
+            for (size_t start = 2; start < this->size; start += 2) {
+                out[start] = in[bitReversed[start]];
+                out[start + 1] = out[start];
             }
 
-            transform(complexIn, out);
+            this->butterflies(out, 2, half);
+            this->lastStage(out);
         }
 
-        ~FFTransformer() {
-            if (complexInAllocated) {
-                delete[] complexIn;
+        /*
+         * Performs FFT (complex -> real) of a conjugate symmetric spectrum via half-size
+         *   complex transform.
+         * Params:
+         *   in - pointer to the input Complex<T> number array, only bins 0 .. size / 2 are read
+         *   out - pointer to the output T number array
+         */
+        void transformHalfToReal(const Type* in, T* out) {
+            if (this->size == 1) {
+                out[0] = in[0].r;
+                return;
+            }
+
+            const size_t half = this->size / 2;
+
+            this->allocateHalf();
+
+            const T scale = forward ? T(1) : T(0.5);
+            const Type *w = &twiddles[half - 1];
+            Type sum, diff, dw;
+
+            // Even outputs come from X[k] + X[k + half], odd ones from (X[k] - X[k + half]) * w^k,
+            //   where X[k + half] = conj(X[half - k])
+            for (size_t k = 0; k < half; ++k) {
+                const Type& xk = in[k];
+                const Type& xc = in[half - k];
+
+                sum.r = xk.r + xc.r;
+                sum.i = xk.i - xc.i;
+                diff.r = xk.r - xc.r;
+                diff.i = xk.i + xc.i;
+
+                dw.r = diff.r * w[k].r - diff.i * w[k].i;
+                dw.i = diff.r * w[k].i + diff.i * w[k].r;
+
+                packed[k].r = (sum.r - dw.i) * scale;
+                packed[k].i = (sum.i + dw.r) * scale;
+            }
+
+            halfTransformer->transform(packed.data(), packed.data());
+
+            for (size_t m = 0; m < half; ++m) {
+                out[2 * m] = packed[m].r;
+                out[2 * m + 1] = packed[m].i;
             }
         }
     };
-}
\ No newline at end of file
+}
@@ -3,7 +3,7 @@
 #include <vector>
 #include <cassert>
 #include <cstddef>
-#include <map>
+#include <algorithm>
 
 #include <Constants.h>
 
@@ -17,7 +17,7 @@ namespace dsperado {
      *   cutoff: filter cutoff frequency
      *   sampleRate: signal sample rate
      */
-    void lowPass(double *inOut, size_t inOutSize, int cutoff, int sampleRate) {
+    inline void lowPass(double *inOut, size_t inOutSize, int cutoff, int sampleRate) {
         double RC = oneDivPI2 / cutoff;
         double dt = 1.0 / sampleRate;
         double alpha = dt / (RC + dt);
@@ -27,6 +27,29 @@ namespace dsperado {
         }
     }
 
+    /*
+     * Low pass filter across the rows of a 2D array: every column is filtered as
+     *   a signal running along the rows. Rows are processed in order, each one for all
+     *   columns at once, so memory is accessed contiguously and the inner loop is
+     *   vectorized. The result is the same as filtering the columns one by one.
+     * Params:
+     *   inOut: pointers to the input-output rows
+     *   rowsNum: number of rows
+     *   colBegin: first column to filter
+     *   colEnd: column after the last one to filter
+     *   alpha: smoothing factor, dt / (RC + dt)
+     */
+    inline void lowPass2D(double **inOut, size_t rowsNum, size_t colBegin, size_t colEnd, double alpha) {
+        for (size_t i = 1; i < rowsNum; ++i) {
+            const double *__restrict prev = inOut[i - 1];
+            double *__restrict cur = inOut[i];
+
+            for (size_t j = colBegin; j < colEnd; ++j) {
+                cur[j] = prev[j] + (alpha * (cur[j] - prev[j]));
+            }
+        }
+    }
+
     /*
      * High pass filter.
      * Params:
@@ -35,7 +58,7 @@ namespace dsperado {
      *   cutoff: filter cutoff frequency
      *   sampleRate: signal sample rate
      */
-    void highPass(double *inOut, size_t inOutSize, int cutoff, int sampleRate) {
+    inline void highPass(double *inOut, size_t inOutSize, int cutoff, int sampleRate) {
         double RC = oneDivPI2 / cutoff;
         double dt = 1.0 / sampleRate;
         double alpha = RC / (RC + dt);
@@ -50,31 +73,55 @@ namespace dsperado {
     }
 
     /*
-     * Smoothed digital differentiator I.
-     * Coefficients are cached once designed.
+     * Smoothed digital differentiator I:
+     *   out[i] = (x[i + 1] + ... + x[i + coeffsNum] - x[i - 1] - ... - x[i - coeffsNum]) / (coeffsNum * (coeffsNum + 1)),
+     *   samples beyond the input are clamped to the edge ones. As all taps are equal,
+     *   sums of both halves of the window are updated as it slides, O(1) per sample.
      * Params:
-     *   inOut: reference to the input-output vector
-     *   inOutSize: input-output array size
+     *   in: pointer to the input array
+     *   out: pointer to the output array, must not overlap the input
+     *   size: input and output arrays size
      *   coeffsNum: number of coefficients (filter length = 2 * coeffsNum + 1)
      */
-    void smoothedDD1(double *inOut, size_t inOutSize, size_t coeffsNum) {
-        assert(coeffsNum >= 2);
+    inline void smoothedDD1(const double *in, double *out, size_t size, size_t coeffsNum) {
+        if (size == 0) {
+            return;
+        }
 
-        static std::map<int, std::vector<double>> coeffsMap;
+        const ptrdiff_t n = (ptrdiff_t) size,
+                        half = (ptrdiff_t) coeffsNum;
+        const double coeff = coeffsNum == 0 ? 0 : 1.0 / coeffsNum / (coeffsNum + 1);
 
-        auto& coeffs = coeffsMap[coeffsNum];
+        auto at = [in, n](ptrdiff_t i) {
+            return in[i < 0 ? 0 : (i >= n ? n - 1 : i)];
+        };
 
-        if (coeffs.empty()) {
-            for (size_t i = 0; i < coeffsNum; ++i) {
-                coeffs.emplace_back(1.0 / coeffsNum / (coeffsNum + 1));
-            }
+        double ahead = 0, behind = 0;
+
+        for (ptrdiff_t k = 1; k <= half; ++k) {
+            ahead += at(k);
+            behind += at(-k);
         }
 
-        for (size_t i = 0; i < inOutSize; ++i) {
-            for (size_t j = 1; j < coeffsNum + 1; ++j) {
-                inOut[i] += coeffs[j - 1] * (inOut[std::min(i + j, inOutSize - 1)] - inOut[std::max(i - j, (size_t) 0)]);
-            }
+        for (ptrdiff_t i = 0; i < n; ++i) {
+            out[i] = coeff * (ahead - behind);
+
+            ahead += at(i + half + 1) - at(i + 1);
+            behind += at(i) - at(i - half);
         }
     }
+
+    /*
+     * Smoothed digital differentiator I in place, see the out of place version.
+     * Params:
+     *   inOut: pointer to the input-output array
+     *   inOutSize: input-output array size
+     *   coeffsNum: number of coefficients (filter length = 2 * coeffsNum + 1)
+     */
+    inline void smoothedDD1(double *inOut, size_t inOutSize, size_t coeffsNum) {
+        const std::vector<double> in(inOut, inOut + inOutSize);
+
+        smoothedDD1(in.data(), inOut, inOutSize, coeffsNum);
+    }
   }
 }
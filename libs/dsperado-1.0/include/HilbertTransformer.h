@@ -10,6 +10,8 @@ namespace dsperado {
      * Hilbert transformer class.
      * Actually creates complex analytic signal, the imaginary part of which
      *   is the actual Hilbert transform result.
+     * Spectrum doubling and masking are fused into the last forward FFT stage,
+     *   and the inverse transform skips the zeroed upper half of the spectrum.
      * Intended to be used if multiple one-size transformations are needed.
      * The first template argument is the desired Complex base type.
      */
@@ -19,13 +21,41 @@ namespace dsperado {
         using Type = dsperado::Complex<T>;
 
         size_t bufferSize;
-        size_t limit1, limit2;
         size_t ind;
-        Type *buffer, *complexIn;
+        Type *buffer;
+        T *imag;
         std::shared_ptr<dsperado::FFTransformer<T, true>> FFT;
         std::shared_ptr<dsperado::FFTransformer<T, false>> IFFT;
 
-        bool complexInAllocated = false;
+        // Leaves Hilbert transforms of in1 and in2 packed into real and imaginary parts of buffer
+        void transformPacked(const T *in1, const T *in2) {
+            const size_t half = bufferSize / 2;
+            T tmp;
+
+            for (ind = 0; ind < bufferSize; ++ind) {
+                buffer[ind].r = in1[ind];
+                buffer[ind].i = in2[ind];
+            }
+
+            FFT->transform(buffer, buffer);
+
+            for (ind = 1; ind < half; ++ind) {
+                tmp = buffer[ind].r;
+                buffer[ind].r = buffer[ind].i;
+                buffer[ind].i = -tmp;
+            }
+
+            for (ind = half + 1; ind < bufferSize; ++ind) {
+                tmp = buffer[ind].r;
+                buffer[ind].r = -buffer[ind].i;
+                buffer[ind].i = tmp;
+            }
+
+            buffer[0].r = buffer[0].i = 0;
+            buffer[half].r = buffer[half].i = 0;
+
+            IFFT->transform(buffer, buffer);
+        }
 
     public:
         /*
@@ -40,12 +70,12 @@ namespace dsperado {
             IFFT = std::make_shared<dsperado::FFTransformer<T, false>>(bufferSize_);
 
             buffer = new dsperado::Complex<T>[bufferSize_];
-
-            auto mod_ = this->bufferSize % 2;
-            limit1 = (this->bufferSize + mod_) / 2;
-            limit2 = limit1 + ~mod_;
+            imag = new T[bufferSize_];
         }
 
+        HilbertTransformer(const HilbertTransformer&) = delete;
+        HilbertTransformer& operator=(const HilbertTransformer&) = delete;
+
         /*
          * Performs Hilbert transform (complex -> complex).
          * Params:
@@ -53,48 +83,88 @@ namespace dsperado {
          *   out - pointer to the output Complex<T> number array
          */
         void transform(const Type *in, Type *out) {
-
-            FFT->transform(in, buffer);
-
-            for (ind = 1; ind < limit1; ++ind) {
-                buffer[ind].r *= 2;
-                buffer[ind].i *= 2;
-            }
-
-            for (ind = limit2; ind < bufferSize; ++ind) {
-                buffer[ind].r = 0;
-                buffer[ind].i = 0;
-            }
-
-            IFFT->transform(buffer, out);
+            FFT->analyticSpectrum(in, buffer);
+            IFFT->transformLowerHalf(buffer, out);
         }
 
         /*
          * Performs Hilbert transform (real -> complex).
+         * Real part of the result is the input itself. Imaginary part is obtained
+         *   from the half spectrum with both transforms running at half size.
          * Params:
          *   in - pointer to the input T number array
          *   out - pointer to the output Complex<T> number array
          */
         void transform(const T *in, Type *out) {
-            if (!complexInAllocated) {
-                complexIn = new Type[bufferSize];
-                complexInAllocated = true;
+            transformImag(in, imag);
+
+            for (ind = 0; ind < bufferSize; ++ind) {
+                out[ind].r = in[ind];
+                out[ind].i = imag[ind];
             }
+        }
+
+        /*
+         * Performs Hilbert transform (real -> real), i.e. computes only the imaginary
+         *   part of the analytic signal. Suits split real / imaginary storage.
+         * Params:
+         *   in - pointer to the input T number array
+         *   out - pointer to the output T number array, must not alias in
+         */
+        void transformImag(const T *in, T *out) {
+            const size_t half = bufferSize / 2;
+
+            // Spectrum of the Hilbert transform is -i * X[k] for positive frequencies
+            FFT->transformReal(in, [this](size_t k, const Type& x) {
+                buffer[k].r = x.i;
+                buffer[k].i = -x.r;
+            });
+
+            buffer[0].r = buffer[0].i = 0;
+            buffer[half].r = buffer[half].i = 0;
+
+            IFFT->transformHalfToReal(buffer, out);
+        }
+
+        /*
+         * Performs two Hilbert transforms (real -> complex) with one forward and
+         *   one inverse FFT. in1 is packed into real parts and in2 into imaginary
+         *   parts; as the transform is linear, multiplying the packed spectrum by
+         *   -i * sign(k) yields both results packed the same way.
+         * Params:
+         *   in1, in2 - pointers to the input T number arrays
+         *   out1, out2 - pointers to the output Complex<T> number arrays
+         */
+        void transform(const T *in1, const T *in2, Type *out1, Type *out2) {
+            transformPacked(in1, in2);
 
             for (ind = 0; ind < bufferSize; ++ind) {
-                complexIn[ind].r = in[ind];
-                complexIn[ind].i = 0;
+                out1[ind].r = in1[ind];
+                out1[ind].i = buffer[ind].r;
+                out2[ind].r = in2[ind];
+                out2[ind].i = buffer[ind].i;
             }
+        }
 
-            transform(complexIn, out);
+        /*
+         * Performs two Hilbert transforms (real -> real) the same way,
+         *   computing only the imaginary parts of the analytic signals.
+         * Params:
+         *   in1, in2 - pointers to the input T number arrays
+         *   out1, out2 - pointers to the output T number arrays
+         */
+        void transformImag(const T *in1, const T *in2, T *out1, T *out2) {
+            transformPacked(in1, in2);
+
+            for (ind = 0; ind < bufferSize; ++ind) {
+                out1[ind] = buffer[ind].r;
+                out2[ind] = buffer[ind].i;
+            }
         }
 
         ~HilbertTransformer() {
             delete[] buffer;
-
-            if (complexInAllocated) {
-                delete[] complexIn;
-            }
+            delete[] imag;
         }
     };
 }
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <Complex.h>
+#include <View2D.h>
+
+namespace dsperado {
+    /*
+     * Complex 2D array with separate real and imaginary planes (structure of arrays).
+     * Both planes live in one zero-initialized 64-byte aligned allocation, the imaginary
+     *   one right after the real one. Rows are pitch elements apart; with the default pitch
+     *   every row starts on a 64-byte boundary, so SIMD code sees unit-stride, aligned rows.
+     * The first template argument is the element base type.
+     */
+    template <typename T>
+    class SplitComplex2D {
+        static_assert(std::is_arithmetic<T>::value, "SplitComplex2D needs an arithmetic base type");
+
+    public:
+        static constexpr size_t alignment = 64;
+
+    private:
+        size_t numRows = 0, numCols = 0, rowPitch = 0;
+        size_t planeSize = 0;
+        T *block = nullptr;
+
+        static size_t roundUp(size_t count) {
+            const size_t step = alignment / sizeof(T);
+            return (count + step - 1) / step * step;
+        }
+
+        void release() {
+            if (block != nullptr) {
+                ::operator delete(block, std::align_val_t(alignment));
+                block = nullptr;
+            }
+        }
+
+    public:
+        SplitComplex2D() = default;
+
+        /*
+         * Constructor.
+         * Params:
+         *   rows - number of rows
+         *   cols - number of elements in a row
+         *   pitch - distance between row starts in elements, 0 rounds cols up
+         *     to a whole number of 64-byte lines
+         */
+        SplitComplex2D(size_t rows, size_t cols, size_t pitch = 0) :
+            numRows(rows), numCols(cols), rowPitch(pitch == 0 ? roundUp(cols) : pitch)
+        {
+            assert(rowPitch >= numCols);
+
+            planeSize = roundUp(numRows * rowPitch);
+
+            const size_t bytes = 2 * planeSize * sizeof(T);
+
+            if (bytes != 0) {
+                block = static_cast<T*>(::operator new(bytes, std::align_val_t(alignment)));
+                std::memset(block, 0, bytes);
+            }
+        }
+
+        SplitComplex2D(const SplitComplex2D&) = delete;
+        SplitComplex2D& operator=(const SplitComplex2D&) = delete;
+
+        SplitComplex2D(SplitComplex2D&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        SplitComplex2D& operator=(SplitComplex2D&& other) noexcept {
+            if (this != &other) {
+                release();
+
+                numRows = other.numRows;
+                numCols = other.numCols;
+                rowPitch = other.rowPitch;
+                planeSize = other.planeSize;
+                block = other.block;
+
+                other.block = nullptr;
+                other.numRows = other.numCols = other.rowPitch = other.planeSize = 0;
+            }
+
+            return *this;
+        }
+
+        ~SplitComplex2D() {
+            release();
+        }
+
+        size_t rows() const { return numRows; }
+        size_t cols() const { return numCols; }
+        size_t pitch() const { return rowPitch; }
+
+        T* re(size_t i) { return block + i * rowPitch; }
+        T* im(size_t i) { return block + planeSize + i * rowPitch; }
+        const T* re(size_t i) const { return block + i * rowPitch; }
+        const T* im(size_t i) const { return block + planeSize + i * rowPitch; }
+
+        dsperado::Complex<T> at(size_t i, size_t j) const {
+            return { re(i)[j], im(i)[j] };
+        }
+
+        void set(size_t i, size_t j, const dsperado::Complex<T>& value) {
+            re(i)[j] = value.r;
+            im(i)[j] = value.i;
+        }
+
+        SplitView2D<T> view() const {
+            return { block, block + planeSize, rowPitch, numRows, numCols };
+        }
+
+        // View of rows x cols elements starting at (row, col), no bounds checks are done
+        SplitView2D<T> tile(size_t row, size_t col, size_t rows, size_t cols) const {
+            return view().tile(row, col, rows, cols);
+        }
+    };
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+
+#include <Complex.h>
+
+namespace dsperado {
+    /*
+     * Read-only view of a row-major 2D array with arbitrary row stride.
+     */
+    template <typename T>
+    struct View2D {
+        const T *data;
+        size_t stride;
+        size_t rows, cols;
+
+        const T* row(size_t i) const {
+            return data + i * stride;
+        }
+
+        const T& at(size_t i, size_t j) const {
+            return data[i * stride + j];
+        }
+    };
+
+    /*
+     * Read-only view of a complex 2D array stored as separate real and imaginary planes
+     *   sharing one row stride.
+     */
+    template <typename T>
+    struct SplitView2D {
+        const T *re, *im;
+        size_t stride;
+        size_t rows, cols;
+
+        const T* rowRe(size_t i) const {
+            return re + i * stride;
+        }
+
+        const T* rowIm(size_t i) const {
+            return im + i * stride;
+        }
+
+        dsperado::Complex<T> at(size_t i, size_t j) const {
+            return { re[i * stride + j], im[i * stride + j] };
+        }
+
+        // Sub-view of rows_ x cols_ elements starting at (row, col), no bounds checks are done
+        SplitView2D tile(size_t row, size_t col, size_t rows_, size_t cols_) const {
+            return { rowRe(row) + col, rowIm(row) + col, stride, rows_, cols_ };
+        }
+    };
+
+    /*
+     * Policy for windows which may cross the view bounds.
+     */
+    enum class Border {
+        // The window lies inside the view, no checks are done
+        Inside,
+        // Out of bounds indices are clamped to the nearest edge
+        Clamp
+    };
+}
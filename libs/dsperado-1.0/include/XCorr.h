@@ -1,6 +1,11 @@
 #pragma once
 
 #include <complex>
+#include <algorithm>
+
+#include <Complex.h>
+#include <View2D.h>
+#include <XCorrKernels.h>
 
 namespace dsperado {
     namespace XCorr {
@@ -55,6 +60,187 @@ namespace dsperado {
             return corr1;
         }
 
+        /*
+         * Complex 2D cross correlation reading the data in place through strided views.
+         * Params:
+         *   m1 - first 2D array view
+         *   m2 - second 2D array view
+         *   row - first window row in views
+         *   col - first window column in views
+         *   rows - window height
+         *   cols - window width
+         *   lag - desired lag (delay)
+         * Template params:
+         *   border - how window parts outside the views are treated
+         * Returns:
+         *   Complex cross correlation value of the window at (row, col)
+         */
+        template <typename T, Border border = Border::Inside>
+        dsperado::Complex<T> XCorr2DComplex(
+                const View2D<dsperado::Complex<T>>& m1,
+                const View2D<dsperado::Complex<T>>& m2,
+                const long row, const long col,
+                const size_t rows, const size_t cols,
+                const int lag) {
+
+            dsperado::Complex<T> corr1;
+
+            corr1.r = 0;
+            corr1.i = 0;
+
+            size_t bound1, bound2;
+
+            if (lag > 0) {
+              bound1 = 0;
+              bound2 = lag;
+            }
+            else {
+              bound1 = abs(lag);
+              bound2 = 0;
+            }
+
+            const dsperado::Complex<T> *tmp1, *tmp2;
+
+            for (size_t n_ = 0; n_ < rows; ++n_) {
+              if (border == Border::Inside) {
+                const dsperado::Complex<T> *row1 = m1.row(row + n_) + col,
+                                           *row2 = m2.row(row + n_) + col + lag;
+
+                for (size_t m_ = bound1; m_ < cols - bound2; ++m_) {
+                  tmp1 = &row1[m_];
+                  tmp2 = &row2[m_];
+                  corr1.r += tmp1->r * tmp2->r + tmp1->i * tmp2->i;
+                  corr1.i += -tmp1->r * tmp2->i + tmp1->i * tmp2->r;
+                }
+              } else {
+                const long lastRow = (long) m1.rows - 1,
+                           lastCol = (long) m1.cols - 1;
+                const size_t realRow = std::min(std::max(row + (long) n_, 0L), lastRow);
+
+                for (size_t m_ = bound1; m_ < cols - bound2; ++m_) {
+                  tmp1 = &m1.at(realRow, std::min(std::max(col + (long) m_, 0L), lastCol));
+                  tmp2 = &m2.at(realRow, std::min(std::max(col + (long) m_ + lag, 0L), lastCol));
+                  corr1.r += tmp1->r * tmp2->r + tmp1->i * tmp2->i;
+                  corr1.i += -tmp1->r * tmp2->i + tmp1->i * tmp2->r;
+                }
+              }
+            }
+
+            return corr1;
+        }
+
+        /*
+         * Complex 2D cross correlation for lags 0, 1 and -1 in a single sweep over the window.
+         * Params:
+         *   m1 - first 2D array view
+         *   m2 - second 2D array view
+         *   row - first window row in views
+         *   col - first window column in views
+         *   rows - window height
+         *   cols - window width
+         * Template params:
+         *   border - how window parts outside the views are treated
+         * Returns:
+         *   Complex cross correlation values of the window at (row, col), equal to
+         *   the ones of XCorr2DComplex with the same window and corresponding lags
+         */
+        template <typename T, Border border = Border::Inside>
+        XCorrLags<T> XCorr2DComplex3Lags(
+                const View2D<dsperado::Complex<T>>& m1,
+                const View2D<dsperado::Complex<T>>& m2,
+                const long row, const long col,
+                const size_t rows, const size_t cols) {
+
+            XCorrLags<T> res;
+
+            res.lag0.r = res.lag0.i = 0;
+            res.lagPlus1.r = res.lagPlus1.i = 0;
+            res.lagMinus1.r = res.lagMinus1.i = 0;
+
+            if (cols == 0) {
+                return res;
+            }
+
+            if (border == Border::Inside) {
+              for (size_t n_ = 0; n_ < rows; ++n_) {
+                const dsperado::Complex<T> *row1 = m1.row(row + n_) + col,
+                                           *row2 = m2.row(row + n_) + col;
+
+                detail::xCorrRow3Lags<T>(
+                  [row1](size_t m_) -> const dsperado::Complex<T>& { return row1[m_]; },
+                  [row2](size_t m_) -> const dsperado::Complex<T>& { return row2[m_]; },
+                  cols, res);
+              }
+
+              return res;
+            }
+
+            const long lastRow = (long) m1.rows - 1,
+                       lastCol = (long) m1.cols - 1;
+
+            auto realCol = [col, lastCol](size_t m_) {
+              return (size_t) std::min(std::max(col + (long) m_, 0L), lastCol);
+            };
+
+            for (size_t n_ = 0; n_ < rows; ++n_) {
+              const size_t realRow = std::min(std::max(row + (long) n_, 0L), lastRow);
+
+              detail::xCorrRow3Lags<T>(
+                [&](size_t m_) -> const dsperado::Complex<T>& { return m1.at(realRow, realCol(m_)); },
+                [&](size_t m_) -> const dsperado::Complex<T>& { return m2.at(realRow, realCol(m_)); },
+                cols, res);
+            }
+
+            return res;
+        }
+
+        /*
+         * Complex 2D cross correlation for lags 0, 1 and -1 of arrays with split real
+         *   and imaginary planes. Windows inside the views use the SIMD kernel best
+         *   suited for the host.
+         * Params and template params are the same as of the View2D version.
+         */
+        template <typename T, Border border = Border::Inside>
+        XCorrLags<T> XCorr2DComplex3Lags(
+                const SplitView2D<T>& m1,
+                const SplitView2D<T>& m2,
+                const long row, const long col,
+                const size_t rows, const size_t cols) {
+
+            XCorrLags<T> res;
+
+            res.lag0.r = res.lag0.i = 0;
+            res.lagPlus1.r = res.lagPlus1.i = 0;
+            res.lagMinus1.r = res.lagMinus1.i = 0;
+
+            if (cols == 0) {
+                return res;
+            }
+
+            if (border == Border::Inside) {
+              xCorr3Lags(m1.tile(row, col, rows, cols), m2.tile(row, col, rows, cols), res);
+              return res;
+            }
+
+            const long lastRow = (long) m1.rows - 1,
+                       lastCol = (long) m1.cols - 1;
+
+            auto realCol = [col, lastCol](size_t m_) {
+              return (size_t) std::min(std::max(col + (long) m_, 0L), lastCol);
+            };
+
+            for (size_t n_ = 0; n_ < rows; ++n_) {
+              const size_t realRow = std::min(std::max(row + (long) n_, 0L), lastRow);
+
+              detail::xCorrRow3Lags<T>(
+                [&](size_t m_) { return m1.at(realRow, realCol(m_)); },
+                [&](size_t m_) { return m2.at(realRow, realCol(m_)); },
+                cols, res);
+            }
+
+            return res;
+        }
+
         /*
          * Normalized complex 2D cross correlation.
          * Params:
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <cstddef>
+
+#include <Complex.h>
+#include <CpuFeatures.h>
+#include <View2D.h>
+
+#if defined(DSPERADO_X86)
+#include <immintrin.h>
+#endif
+
+namespace dsperado {
+    namespace XCorr {
+        /*
+         * Complex cross correlation values for lags 0, 1 and -1.
+         */
+        template <typename T>
+        struct XCorrLags {
+            dsperado::Complex<T> lag0, lagPlus1, lagMinus1;
+        };
+
+        namespace detail {
+            // acc += a * conj(b)
+            template <typename T>
+            inline void conjMulAdd(dsperado::Complex<T>& acc, const dsperado::Complex<T>& a, const dsperado::Complex<T>& b) {
+                acc.r += a.r * b.r + a.i * b.i;
+                acc.i += -a.r * b.i + a.i * b.r;
+            }
+
+            // Accumulates one window row for all three lags, a(m_) and b(m_) return row elements.
+            // Lag 1 is undefined for the last element and lag -1 for the first one, so these are peeled
+            template <typename T, typename A, typename B>
+            inline void xCorrRow3Lags(A&& a, B&& b, const size_t cols, XCorrLags<T>& res) {
+                conjMulAdd(res.lag0, a(0), b(0));
+
+                if (cols < 2) {
+                    return;
+                }
+
+                conjMulAdd(res.lagPlus1, a(0), b(1));
+
+                for (size_t m_ = 1; m_ < cols - 1; ++m_) {
+                    const dsperado::Complex<T>& a0 = a(m_);
+
+                    conjMulAdd(res.lag0, a0, b(m_));
+                    conjMulAdd(res.lagPlus1, a0, b(m_ + 1));
+                    conjMulAdd(res.lagMinus1, a0, b(m_ - 1));
+                }
+
+                conjMulAdd(res.lag0, a(cols - 1), b(cols - 1));
+                conjMulAdd(res.lagMinus1, a(cols - 1), b(cols - 2));
+            }
+        }
+
+        /*
+         * Window kernels: accumulate w1 x conj(w2) over a window for lags 0, 1 and -1 into res.
+         * Params:
+         *   w1 - window tile of the first array
+         *   w2 - window tile of the second array, of the same size
+         *   res - accumulated values
+         */
+        template <typename T>
+        inline void xCorr3LagsScalar(const SplitView2D<T>& w1, const SplitView2D<T>& w2, XCorrLags<T>& res) {
+            for (size_t n_ = 0; n_ < w1.rows; ++n_) {
+                const T *re1 = w1.rowRe(n_), *im1 = w1.rowIm(n_),
+                        *re2 = w2.rowRe(n_), *im2 = w2.rowIm(n_);
+
+                detail::xCorrRow3Lags<T>(
+                  [re1, im1](size_t m_) { return dsperado::Complex<T>{ re1[m_], im1[m_] }; },
+                  [re2, im2](size_t m_) { return dsperado::Complex<T>{ re2[m_], im2[m_] }; },
+                  w1.cols, res);
+            }
+        }
+
+        namespace detail {
+            // Peeled first and last elements of a row, shared by the SIMD kernels
+            template <typename T>
+            inline void xCorrRowEdges3Lags(const SplitView2D<T>& w1, const SplitView2D<T>& w2,
+                                           const size_t n_, XCorrLags<T>& res) {
+                const size_t last = w1.cols - 1;
+
+                conjMulAdd(res.lag0, w1.at(n_, 0), w2.at(n_, 0));
+                conjMulAdd(res.lagPlus1, w1.at(n_, 0), w2.at(n_, 1));
+                conjMulAdd(res.lag0, w1.at(n_, last), w2.at(n_, last));
+                conjMulAdd(res.lagMinus1, w1.at(n_, last), w2.at(n_, last - 1));
+            }
+        }
+
+#if defined(DSPERADO_X86)
+        namespace detail {
+            // Lagged products of one vector of a with the vectors of b, four independent
+            // accumulators per lag keep the FMA chains short
+            struct AccumulatorsAVX2 {
+                __m256d r1, r2, i1, i2;
+            };
+
+            DSPERADO_TARGET("avx2,fma")
+            inline void conjMulAddAVX2(AccumulatorsAVX2& acc, const __m256d ar, const __m256d ai,
+                                       const __m256d br, const __m256d bi) {
+                acc.r1 = _mm256_fmadd_pd(ar, br, acc.r1);
+                acc.r2 = _mm256_fmadd_pd(ai, bi, acc.r2);
+                acc.i1 = _mm256_fmadd_pd(ai, br, acc.i1);
+                acc.i2 = _mm256_fnmadd_pd(ar, bi, acc.i2);
+            }
+
+            DSPERADO_TARGET("avx2,fma")
+            inline void reduceAVX2(const AccumulatorsAVX2& acc, dsperado::Complex<double>& res) {
+                const __m256d r = _mm256_add_pd(acc.r1, acc.r2),
+                              i = _mm256_add_pd(acc.i1, acc.i2);
+                // Pairwise sums of both parts: {r0 + r1, i0 + i1, r2 + r3, i2 + i3}
+                const __m256d h = _mm256_hadd_pd(r, i);
+                const __m128d s = _mm_add_pd(_mm256_castpd256_pd128(h), _mm256_extractf128_pd(h, 1));
+
+                res.r += _mm_cvtsd_f64(s);
+                res.i += _mm_cvtsd_f64(_mm_unpackhi_pd(s, s));
+            }
+
+            struct AccumulatorsAVX512 {
+                __m512d r1, r2, i1, i2;
+            };
+
+            DSPERADO_TARGET("avx512f")
+            inline void conjMulAddAVX512(AccumulatorsAVX512& acc, const __m512d ar, const __m512d ai,
+                                         const __m512d br, const __m512d bi) {
+                acc.r1 = _mm512_fmadd_pd(ar, br, acc.r1);
+                acc.r2 = _mm512_fmadd_pd(ai, bi, acc.r2);
+                acc.i1 = _mm512_fmadd_pd(ai, br, acc.i1);
+                acc.i2 = _mm512_fnmadd_pd(ar, bi, acc.i2);
+            }
+
+            // Sum of all elements in the order of _mm512_reduce_add_pd, whose unmasked
+            // half extraction GCC 12 reports as possibly uninitialized
+            DSPERADO_TARGET("avx512f")
+            inline double reduceAddAVX512(const __m512d v) {
+                const __m256d h = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xF, v, 1),
+                                                _mm512_maskz_extractf64x4_pd(0xF, v, 0));
+                const __m128d s = _mm_add_pd(_mm256_extractf128_pd(h, 1), _mm256_castpd256_pd128(h));
+
+                return _mm_cvtsd_f64(s) + _mm_cvtsd_f64(_mm_unpackhi_pd(s, s));
+            }
+
+            DSPERADO_TARGET("avx512f")
+            inline void reduceAVX512(const AccumulatorsAVX512& acc, dsperado::Complex<double>& res) {
+                res.r += reduceAddAVX512(_mm512_add_pd(acc.r1, acc.r2));
+                res.i += reduceAddAVX512(_mm512_add_pd(acc.i1, acc.i2));
+            }
+        }
+
+        /*
+         * AVX2 + FMA window kernel, four complex numbers per register.
+         * With split planes a * conj(b) needs no shuffles:
+         *   Re += a.r * b.r + a.i * b.i, Im += a.i * b.r - a.r * b.i.
+         * Peeled edges and the row remainder are accumulated in scalar.
+         */
+        DSPERADO_TARGET("avx2,fma")
+        inline void xCorr3LagsAVX2(const SplitView2D<double>& w1, const SplitView2D<double>& w2,
+                                   XCorrLags<double>& res) {
+            const size_t rows = w1.rows, cols = w1.cols;
+
+            if (cols < 2) {
+                xCorr3LagsScalar(w1, w2, res);
+                return;
+            }
+
+            const __m256d zero = _mm256_setzero_pd();
+            detail::AccumulatorsAVX2 acc0 = { zero, zero, zero, zero },
+                                     accPlus = acc0, accMinus = acc0;
+
+            // Local copy, so that stores to res are not assumed to alias the planes
+            XCorrLags<double> scalar = res;
+
+            for (size_t n_ = 0; n_ < rows; ++n_) {
+                const double *re1 = w1.rowRe(n_), *im1 = w1.rowIm(n_),
+                             *re2 = w2.rowRe(n_), *im2 = w2.rowIm(n_);
+
+                size_t m_ = 1;
+
+                for (; m_ + 4 < cols; m_ += 4) {
+                    const __m256d ar = _mm256_loadu_pd(re1 + m_),
+                                  ai = _mm256_loadu_pd(im1 + m_);
+
+                    detail::conjMulAddAVX2(acc0, ar, ai, _mm256_loadu_pd(re2 + m_), _mm256_loadu_pd(im2 + m_));
+                    detail::conjMulAddAVX2(accPlus, ar, ai, _mm256_loadu_pd(re2 + m_ + 1), _mm256_loadu_pd(im2 + m_ + 1));
+                    detail::conjMulAddAVX2(accMinus, ar, ai, _mm256_loadu_pd(re2 + m_ - 1), _mm256_loadu_pd(im2 + m_ - 1));
+                }
+
+                for (; m_ < cols - 1; ++m_) {
+                    const dsperado::Complex<double> a = { re1[m_], im1[m_] };
+
+                    detail::conjMulAdd(scalar.lag0, a, { re2[m_], im2[m_] });
+                    detail::conjMulAdd(scalar.lagPlus1, a, { re2[m_ + 1], im2[m_ + 1] });
+                    detail::conjMulAdd(scalar.lagMinus1, a, { re2[m_ - 1], im2[m_ - 1] });
+                }
+
+                detail::xCorrRowEdges3Lags(w1, w2, n_, scalar);
+            }
+
+            detail::reduceAVX2(acc0, scalar.lag0);
+            detail::reduceAVX2(accPlus, scalar.lagPlus1);
+            detail::reduceAVX2(accMinus, scalar.lagMinus1);
+
+            res = scalar;
+        }
+
+        /*
+         * AVX-512F window kernel, eight complex numbers per register.
+         * The row remainder is processed with masked loads instead of a scalar loop.
+         */
+        DSPERADO_TARGET("avx512f")
+        inline void xCorr3LagsAVX512(const SplitView2D<double>& w1, const SplitView2D<double>& w2,
+                                     XCorrLags<double>& res) {
+            const size_t rows = w1.rows, cols = w1.cols;
+
+            if (cols < 2) {
+                xCorr3LagsScalar(w1, w2, res);
+                return;
+            }
+
+            const __m512d zero = _mm512_setzero_pd();
+            detail::AccumulatorsAVX512 acc0 = { zero, zero, zero, zero },
+                                       accPlus = acc0, accMinus = acc0;
+
+            XCorrLags<double> scalar = res;
+
+            const __mmask8 tailMask = (__mmask8) ((1u << ((cols - 2) % 8)) - 1);
+
+            for (size_t n_ = 0; n_ < rows; ++n_) {
+                const double *re1 = w1.rowRe(n_), *im1 = w1.rowIm(n_),
+                             *re2 = w2.rowRe(n_), *im2 = w2.rowIm(n_);
+
+                size_t m_ = 1;
+
+                for (; m_ + 8 < cols; m_ += 8) {
+                    const __m512d ar = _mm512_loadu_pd(re1 + m_),
+                                  ai = _mm512_loadu_pd(im1 + m_);
+
+                    detail::conjMulAddAVX512(acc0, ar, ai, _mm512_loadu_pd(re2 + m_), _mm512_loadu_pd(im2 + m_));
+                    detail::conjMulAddAVX512(accPlus, ar, ai, _mm512_loadu_pd(re2 + m_ + 1), _mm512_loadu_pd(im2 + m_ + 1));
+                    detail::conjMulAddAVX512(accMinus, ar, ai, _mm512_loadu_pd(re2 + m_ - 1), _mm512_loadu_pd(im2 + m_ - 1));
+                }
+
+                if (tailMask != 0) {
+                    // Masked out lanes are zeroed and not read
+                    const __m512d ar = _mm512_maskz_loadu_pd(tailMask, re1 + m_),
+                                  ai = _mm512_maskz_loadu_pd(tailMask, im1 + m_);
+
+                    detail::conjMulAddAVX512(acc0, ar, ai,
+                        _mm512_maskz_loadu_pd(tailMask, re2 + m_), _mm512_maskz_loadu_pd(tailMask, im2 + m_));
+                    detail::conjMulAddAVX512(accPlus, ar, ai,
+                        _mm512_maskz_loadu_pd(tailMask, re2 + m_ + 1), _mm512_maskz_loadu_pd(tailMask, im2 + m_ + 1));
+                    detail::conjMulAddAVX512(accMinus, ar, ai,
+                        _mm512_maskz_loadu_pd(tailMask, re2 + m_ - 1), _mm512_maskz_loadu_pd(tailMask, im2 + m_ - 1));
+                }
+
+                detail::xCorrRowEdges3Lags(w1, w2, n_, scalar);
+            }
+
+            detail::reduceAVX512(acc0, scalar.lag0);
+            detail::reduceAVX512(accPlus, scalar.lagPlus1);
+            detail::reduceAVX512(accMinus, scalar.lagMinus1);
+
+            res = scalar;
+        }
+#endif
+
+        using XCorr3LagsKernel = void (*)(const SplitView2D<double>&, const SplitView2D<double>&,
+                                          XCorrLags<double>&);
+
+        /*
+         * Returns the window kernel for the given SIMD level, falling back to scalar
+         *   if the level has no implementation on this platform.
+         */
+        inline XCorr3LagsKernel xCorr3LagsKernel(const SimdLevel level) {
+#if defined(DSPERADO_X86)
+            switch (level) {
+                case SimdLevel::AVX512:
+                    return xCorr3LagsAVX512;
+                case SimdLevel::AVX2:
+                    return xCorr3LagsAVX2;
+                default:
+                    break;
+            }
+#endif
+            (void) level;
+            return xCorr3LagsScalar<double>;
+        }
+
+        /*
+         * Window kernel with the best implementation for the host.
+         */
+        template <typename T>
+        inline void xCorr3Lags(const SplitView2D<T>& w1, const SplitView2D<T>& w2, XCorrLags<T>& res) {
+            xCorr3LagsScalar(w1, w2, res);
+        }
+
+        inline void xCorr3Lags(const SplitView2D<double>& w1, const SplitView2D<double>& w2,
+                               XCorrLags<double>& res) {
+            static const XCorr3LagsKernel kernel = xCorr3LagsKernel(simdLevel());
+
+            kernel(w1, w2, res);
+        }
+    }
+}
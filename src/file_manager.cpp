@@ -1,5 +1,8 @@
 #include <file_manager.h>
 
+#include <algorithm>
+#include <cctype>
+
 bool UST::FileManager::openBinStream(
   const std::string& fileName, const std::vector<std::string>& vars, int beams, int vals)
 {
@@ -114,31 +117,160 @@ void UST::FileManager::closeBinStream() {
   delete[] b_v;
 }
 
-// Read RAW data file
-bool UST::FileManager::readRAWFile(const std::string& fileName, short **rawBeamData, int beams, int vals) {
+// Open RAW data file and check that it holds exactly one frame of expected bytes
+static FILE *openRAWFile(const std::string& fileName, size_t expected) {
+  std::error_code error;
+  const auto size = std::filesystem::file_size(fileName, error);
+
+  if (error) {
+    logger << "Error opening input file " << fileName << ": " << error.message() << std::endl;
+    return nullptr;
+  }
+
+  if (size != expected) {
+    logger << "Invalid input file " << fileName << ": " << size << " bytes, expected " << expected << std::endl;
+    return nullptr;
+  }
+
   FILE *in;
 
 #ifdef _MSC_VER
   if (fopen_s(&in, fileName.c_str(), "rb")) {
-          logger << "Error opening input file " << fileName << std::endl;
-          return false;
-        }
+    logger << "Error opening input file " << fileName << std::endl;
+    return nullptr;
+  }
 #else
   in = fopen(fileName.c_str(), "rb");
 
   if (!in) {
     logger << "Error opening input file " << fileName << std::endl;
-    return false;
+    return nullptr;
   }
 #endif
 
+  return in;
+}
+
+static bool reportShortRead(const std::string& fileName, size_t read, size_t expected) {
+  if (read != expected) {
+    logger << "Short read from input file " << fileName << ": " << read << " of " << expected << " samples" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// Read RAW data file
+bool UST::FileManager::readRAWFile(const std::string& fileName, short **rawBeamData, int beams, int vals) {
+  FILE *in = openRAWFile(fileName, (size_t) beams * vals * sizeof(short));
+
+  if (!in) {
+    return false;
+  }
+
+  size_t read = 0;
+
   for (int i = 0; i < beams; ++i) {
-    for (int j = 0; j < vals; ++j) {
-      fread(&rawBeamData[i][j], sizeof(short), 1, in);
+    const size_t got = fread(rawBeamData[i], sizeof(short), vals, in);
+
+    read += got;
+
+    if (got != (size_t) vals) {
+      break;
     }
   }
 
   fclose(in);
 
-  return true;
-}
\ No newline at end of file
+  return reportShortRead(fileName, read, (size_t) beams * vals);
+}
+
+// Read RAW data file into a contiguous frame
+bool UST::FileManager::readRAWFrame(const std::string& fileName, short *frame, int beams, int vals) {
+  const size_t samples = (size_t) beams * vals;
+
+  FILE *in = openRAWFile(fileName, samples * sizeof(short));
+
+  if (!in) {
+    return false;
+  }
+
+  const size_t read = fread(frame, sizeof(short), samples, in);
+
+  fclose(in);
+
+  return reportShortRead(fileName, read, samples);
+}
+
+// Compare names with runs of digits compared as numbers
+static bool naturalLess(const std::string& a, const std::string& b) {
+  size_t i = 0, j = 0;
+
+  while (i < a.size() && j < b.size()) {
+    if (std::isdigit((unsigned char) a[i]) && std::isdigit((unsigned char) b[j])) {
+      // Skip leading zeros, then a longer run is a larger number
+      size_t ai = i, bj = j;
+
+      while (ai < a.size() && a[ai] == '0') {
+        ai++;
+      }
+
+      while (bj < b.size() && b[bj] == '0') {
+        bj++;
+      }
+
+      size_t aEnd = ai, bEnd = bj;
+
+      while (aEnd < a.size() && std::isdigit((unsigned char) a[aEnd])) {
+        aEnd++;
+      }
+
+      while (bEnd < b.size() && std::isdigit((unsigned char) b[bEnd])) {
+        bEnd++;
+      }
+
+      if (aEnd - ai != bEnd - bj) {
+        return aEnd - ai < bEnd - bj;
+      }
+
+      const int order = a.compare(ai, aEnd - ai, b, bj, bEnd - bj);
+
+      if (order != 0) {
+        return order < 0;
+      }
+
+      i = aEnd;
+      j = bEnd;
+    } else {
+      if (a[i] != b[j]) {
+        return a[i] < b[j];
+      }
+
+      i++;
+      j++;
+    }
+  }
+
+  if (a.size() - i != b.size() - j) {
+    return a.size() - i < b.size() - j;
+  }
+
+  // Equal up to leading zeros
+  return a < b;
+}
+
+std::vector<std::filesystem::path> UST::FileManager::listRAWFiles(const std::string& dir) {
+  std::vector<std::filesystem::path> files;
+
+  for (const auto& p : std::filesystem::directory_iterator(dir)) {
+    if (p.path().extension() == ".raw") {
+      files.push_back(p.path());
+    }
+  }
+
+  std::sort(files.begin(), files.end(), [](const std::filesystem::path& a, const std::filesystem::path& b) {
+    return naturalLess(a.filename().string(), b.filename().string());
+  });
+
+  return files;
+}
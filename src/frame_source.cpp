@@ -0,0 +1,423 @@
+#include <frame_source.h>
+
+#include <file_manager.h>
+#include <logger.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+UST::FrameSource::FrameSource(std::vector<std::string> files_, int beams_, int vals_, size_t lookahead_) :
+    files(std::move(files_)),
+    beams(beams_),
+    vals(vals_),
+    lookahead(lookahead_)
+{}
+
+std::unique_ptr<UST::FrameSource> UST::FrameSource::create(
+  const std::string& backend, std::vector<std::string> files, int beams, int vals, size_t lookahead, size_t held)
+{
+  if (backend == "mmap") {
+#if defined(__unix__) || defined(__APPLE__)
+    return std::unique_ptr<FrameSource>(new MappedFrameSource(std::move(files), beams, vals, lookahead));
+#else
+    logger << "Memory mapped frames are not supported, reading them instead\n";
+#endif
+  } else if (backend == "uring") {
+#if defined(UST_X_HAVE_LIBURING)
+    std::unique_ptr<UringFrameSource> source(new UringFrameSource(files, beams, vals, lookahead, held));
+
+    if (source->isInitialized()) {
+      return source;
+    }
+
+    logger << "io_uring is not available, reading frames instead\n";
+#else
+    (void) held;
+
+    logger << "Built without io_uring support, reading frames instead\n";
+#endif
+  } else if (backend != "read") {
+    return nullptr;
+  }
+
+  return std::unique_ptr<FrameSource>(new ReadFrameSource(std::move(files), beams, vals, lookahead));
+}
+
+bool UST::ReadFrameSource::acquire(size_t index, short *buffer, FrameView& view) {
+#if defined(__linux__)
+  // Start reading the next frames in, errors are reported when they are acquired
+  advised = std::max(advised, index + 1);
+
+  for (; advised <= index + lookahead && advised < files.size(); ++advised) {
+    const int fd = open(files[advised].c_str(), O_RDONLY);
+
+    if (fd >= 0) {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+      close(fd);
+    }
+  }
+#endif
+
+  if (!FileManager::readRAWFrame(files[index], buffer, beams, vals)) {
+    return false;
+  }
+
+  view = {buffer, (size_t) vals, (size_t) beams, (size_t) vals};
+
+  return true;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+UST::MappedFrameSource::~MappedFrameSource() {
+  for (auto& mapping : mappings) {
+    munmap(mapping.second.address, mapping.second.length);
+  }
+}
+
+UST::MappedFrameSource::Mapping *UST::MappedFrameSource::map(size_t index, bool report) {
+  auto found = mappings.find(index);
+
+  if (found != mappings.end()) {
+    return &found->second;
+  }
+
+  const std::string& fileName = files[index];
+  const size_t expected = (size_t) beams * vals * sizeof(short);
+
+  const int fd = open(fileName.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    if (report) {
+      logger << "Error opening input file " << fileName << std::endl;
+    }
+    return nullptr;
+  }
+
+  struct stat info;
+
+  if (fstat(fd, &info) != 0) {
+    info.st_size = 0;
+  }
+
+  if ((size_t) info.st_size != expected) {
+    if (report) {
+      logger << "Invalid input file " << fileName << ": " << (long long) info.st_size
+             << " bytes, expected " << expected << std::endl;
+    }
+    close(fd);
+    return nullptr;
+  }
+
+  void *address = mmap(nullptr, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  // The mapping keeps the file referenced
+  close(fd);
+
+  if (address == MAP_FAILED) {
+    if (report) {
+      logger << "Error mapping input file " << fileName << std::endl;
+    }
+    return nullptr;
+  }
+
+  // Samples are read once front to back, pages may be dropped right behind
+  madvise(address, expected, MADV_SEQUENTIAL);
+
+  Mapping& mapping = mappings[index];
+
+  mapping.address = address;
+  mapping.length = expected;
+
+  return &mapping;
+}
+
+bool UST::MappedFrameSource::acquire(size_t index, short *, FrameView& view) {
+  std::lock_guard<std::mutex> lock(m);
+
+  Mapping *mapping = map(index, true);
+
+  if (mapping == nullptr) {
+    return false;
+  }
+
+  view = {static_cast<const short*>(mapping->address), (size_t) vals, (size_t) beams, (size_t) vals};
+
+  // Start reading the next frames in, an unreadable one is reported when acquired
+  for (size_t next = index + 1; next <= index + lookahead && next < files.size(); ++next) {
+    if (mappings.count(next) == 0) {
+      if (Mapping *ahead = map(next, false)) {
+        madvise(ahead->address, ahead->length, MADV_WILLNEED);
+      }
+    }
+  }
+
+  return true;
+}
+
+void UST::MappedFrameSource::release(size_t index) {
+  std::lock_guard<std::mutex> lock(m);
+
+  auto found = mappings.find(index);
+
+  if (found != mappings.end()) {
+    munmap(found->second.address, found->second.length);
+    mappings.erase(found);
+  }
+}
+#endif
+
+#if defined(UST_X_HAVE_LIBURING)
+UST::UringFrameSource::UringFrameSource(
+  std::vector<std::string> files_, int beams_, int vals_, size_t lookahead_, size_t held) :
+    FrameSource(std::move(files_), beams_, vals_, lookahead_),
+    frameBytes((size_t) beams_ * vals_ * sizeof(short)),
+    buffers((lookahead_ + held + 1) * beams_ * vals_),
+    slots(lookahead_ + held + 1)
+{
+  // Every slot has at most one read in flight
+  if (io_uring_queue_init((unsigned) std::min<size_t>(slots.size(), 4096), &ring, 0) < 0) {
+    return;
+  }
+
+  initialized = true;
+
+  // Registering pins the buffers, which may exceed the locked memory limit.
+  // Frames are read into the same buffers then, pinned on every read
+  std::vector<iovec> iovecs(slots.size());
+
+  for (size_t slot = 0; slot < slots.size(); ++slot) {
+    iovecs[slot].iov_base = slotData(slot);
+    iovecs[slot].iov_len = frameBytes;
+  }
+
+  registered = io_uring_register_buffers(&ring, iovecs.data(), (unsigned) iovecs.size()) == 0;
+}
+
+UST::UringFrameSource::~UringFrameSource() {
+  if (!initialized) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(m);
+
+  // The kernel writes into the buffers until the reads complete
+  auto reading = [this]() {
+    return std::any_of(slots.begin(), slots.end(), [](const Slot& slot) {
+      return slot.state == SlotState::Reading;
+    });
+  };
+
+  while (reading() && complete(lock)) {}
+
+  io_uring_queue_exit(&ring);
+}
+
+size_t UST::UringFrameSource::findFreeSlot() const {
+  for (size_t slot = 0; slot < slots.size(); ++slot) {
+    if (slots[slot].state == SlotState::Free) {
+      return slot;
+    }
+  }
+
+  return slots.size();
+}
+
+bool UST::UringFrameSource::queueRead(size_t index, size_t slot, bool report) {
+  const std::string& fileName = files[index];
+
+  const int fd = open(fileName.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    if (report) {
+      logger << "Error opening input file " << fileName << std::endl;
+    }
+    return false;
+  }
+
+  struct stat info;
+
+  if (fstat(fd, &info) != 0) {
+    info.st_size = 0;
+  }
+
+  if ((size_t) info.st_size != frameBytes) {
+    if (report) {
+      logger << "Invalid input file " << fileName << ": " << (long long) info.st_size
+             << " bytes, expected " << frameBytes << std::endl;
+    }
+    close(fd);
+    return false;
+  }
+
+  Slot& s = slots[slot];
+
+  s.state = SlotState::Reading;
+  s.fd = fd;
+  s.done = 0;
+  s.error = 0;
+
+  frameSlots[index] = slot;
+
+  queueRest(slot);
+
+  return true;
+}
+
+void UST::UringFrameSource::queueRest(size_t slot) {
+  io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+
+  // The submission queue is only shorter than the slots for very deep read ahead
+  if (sqe == nullptr) {
+    io_uring_submit(&ring);
+    sqe = io_uring_get_sqe(&ring);
+  }
+
+  const Slot& s = slots[slot];
+  char *data = reinterpret_cast<char*>(slotData(slot)) + s.done;
+  const unsigned bytes = (unsigned) (frameBytes - s.done);
+
+  if (registered) {
+    io_uring_prep_read_fixed(sqe, s.fd, data, bytes, s.done, (int) slot);
+  } else {
+    io_uring_prep_read(sqe, s.fd, data, bytes, s.done);
+  }
+
+  io_uring_sqe_set_data(sqe, reinterpret_cast<void*>((uintptr_t) slot));
+}
+
+bool UST::UringFrameSource::complete(std::unique_lock<std::mutex>& lock) {
+  io_uring_cqe *cqe = nullptr;
+
+  // Frames may be released meanwhile
+  lock.unlock();
+  const int waited = io_uring_wait_cqe(&ring, &cqe);
+  lock.lock();
+
+  if (waited == -EINTR) {
+    return true;
+  }
+
+  if (waited < 0) {
+    return false;
+  }
+
+  const size_t slot = (size_t) (uintptr_t) io_uring_cqe_get_data(cqe);
+  const int result = cqe->res;
+
+  io_uring_cqe_seen(&ring, cqe);
+
+  Slot& s = slots[slot];
+
+  if (result < 0) {
+    s.error = -result;
+  } else {
+    s.done += (size_t) result;
+
+    // A short read is continued, unless the file was truncated meanwhile
+    if (result > 0 && s.done < frameBytes) {
+      queueRest(slot);
+      io_uring_submit(&ring);
+      return true;
+    }
+  }
+
+  s.state = s.done == frameBytes ? SlotState::Ready : SlotState::Failed;
+
+  close(s.fd);
+  s.fd = -1;
+
+  return true;
+}
+
+bool UST::UringFrameSource::acquire(size_t index, short *, FrameView& view) {
+  std::lock_guard<std::mutex> ringLock(ringMutex);
+  std::unique_lock<std::mutex> lock(m);
+
+  // 1) Queue the read of the frame unless it was read ahead. Without a free slot
+  // wait for a held frame to be released
+
+  if (frameSlots.count(index) == 0) {
+    size_t slot = slots.size();
+
+    slotFreed.wait(lock, [this, &slot]() {
+      return (slot = findFreeSlot()) != slots.size();
+    });
+
+    if (!queueRead(index, slot, true)) {
+      return false;
+    }
+  }
+
+  // 2) Queue reads of the next frames into the free slots, an unreadable one
+  // is reported when acquired
+
+  submitted = std::max(submitted, index + 1);
+
+  for (; submitted <= index + lookahead && submitted < files.size(); ++submitted) {
+    const size_t slot = findFreeSlot();
+
+    if (slot == slots.size()) {
+      break;
+    }
+
+    if (frameSlots.count(submitted) == 0) {
+      queueRead(submitted, slot, false);
+    }
+  }
+
+  // 3) Submit all queued reads at once and wait for the frame
+
+  io_uring_submit(&ring);
+
+  const size_t slot = frameSlots[index];
+  Slot& s = slots[slot];
+
+  while (s.state == SlotState::Reading) {
+    if (!complete(lock)) {
+      logger << "Error waiting for input file " << files[index] << std::endl;
+      return false;
+    }
+  }
+
+  if (s.state == SlotState::Failed) {
+    if (s.error != 0) {
+      logger << "Error reading input file " << files[index] << ": " << std::strerror(s.error) << std::endl;
+    } else {
+      logger << "Short read from input file " << files[index] << ": " << s.done
+             << " of " << frameBytes << " bytes" << std::endl;
+    }
+
+    s.state = SlotState::Free;
+    frameSlots.erase(index);
+
+    return false;
+  }
+
+  view = {slotData(slot), (size_t) vals, (size_t) beams, (size_t) vals};
+
+  return true;
+}
+
+void UST::UringFrameSource::release(size_t index) {
+  std::lock_guard<std::mutex> lock(m);
+
+  auto found = frameSlots.find(index);
+
+  // A frame still being read keeps its slot until the read completes
+  if (found != frameSlots.end() && slots[found->second].state != SlotState::Reading) {
+    slots[found->second].state = SlotState::Free;
+    frameSlots.erase(found);
+    slotFreed.notify_one();
+  }
+}
+#endif
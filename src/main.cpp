@@ -1,12 +1,21 @@
 #include <INIReader.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
 #include <Constants.h>
 
 #include <defines.h>
 #include <xcorr_engine.h>
 #include <monitor.h>
 #include <file_manager.h>
+#include <frame_source.h>
 #include <logger.h>
+#include <pipeline.h>
+#include <post_processor.h>
+#include <shard.h>
 
 /*************************
  * PROCESSING PARAMETERS *
@@ -22,15 +31,159 @@ constexpr double alpha = dt / (RC + dt);
 
 // Low pass differentating
 constexpr size_t filterLength = 5;
-constexpr double coeff = 1.0 / (filterLength * (filterLength + 1));
 
 // XCorr method window
 constexpr size_t wSizeAxial = 26;
 constexpr size_t wSizeLateral = 4;
 
-int main() {
+// A frame travelling through the processing pipeline. Slots are allocated once
+// and reused for later frames
+struct FrameSlot {
+  int cnt = 0;
+  int step = 0;
+
+  // False for the reference frame, which has no previous one to be compared with
+  bool hasShift = false;
+
+  // Raw beam data acquired from the frame source, held until it is Hilbert transformed.
+  // rawData is the storage for sources which copy frames
+  size_t sourceIndex = 0;
+  UST::FrameView raw = {};
+  std::vector<short> rawData;
+
+  // Shift, as rows of contiguous storage
+  std::vector<double> outData;
+  std::vector<double*> out;
+
+  // Accumulated result after this frame
+  UST::Field field;
+
+  FrameSlot(int beams, int vals, bool rawStorage) :
+    rawData(rawStorage ? (size_t) beams * vals : 0),
+    outData((size_t) beams * vals), out(beams),
+    field(beams, std::vector<double>(vals))
+  {
+    for (int i = 0; i < beams; ++i) {
+      out[i] = outData.data() + (size_t) i * vals;
+    }
+  }
+};
+
+// Frames processed together: their Hilbert transforms and shifts are computed at once,
+// then the shifts are filtered independently
+struct FrameBatch {
+  std::vector<std::unique_ptr<FrameSlot>> frames;
+  size_t size = 0;
+
+  FrameBatch(size_t batchSize, int beams, int vals, bool rawStorage) {
+    for (size_t k = 0; k < batchSize; ++k) {
+      frames.emplace_back(new FrameSlot(beams, vals, rawStorage));
+    }
+  }
+};
+
+// Merge shard results in the given order: every step gets the end-of-shard sums
+// of all previous shards added, then goes to the usual output
+static bool mergeShards(
+  const std::vector<std::string>& dirs,
+  int beams,
+  int vals,
+  Monitoring::Monitor& monitor,
+  UST::FileManager& fileManager,
+  const UST::PairField& areaField)
+{
+  UST::Field offset(beams, std::vector<double>(vals)), field, sum;
+
+  // The first step is 2, the first frame is a reference only
+  int lastStep = 1;
+
+  for (auto& dir : dirs) {
+    UST::ShardReader shard;
+
+    int stepsNum = 0, stepsRead = 0;
+
+    if (!shard.open(dir, beams, vals) || !shard.readSum(sum, stepsNum)) {
+      return false;
+    }
+
+    int step;
+
+    while (shard.next(step, field)) {
+      if (step != lastStep + 1) {
+        logger << "Shard " << dir << " has step " << step << " where step " << lastStep + 1 << " is expected\n";
+        return false;
+      }
+
+      lastStep = step;
+      stepsRead++;
+
+      for (int i = 0; i < beams; ++i) {
+        for (int j = 0; j < vals; ++j) {
+          field[i][j] += offset[i][j];
+        }
+      }
+
+      monitor.process(field, "epsilon", std::to_string(step));
+
+      std::vector<std::reference_wrapper<UST::Field>> fieldsToOutput;
+      fieldsToOutput.emplace_back(field);
+      fileManager.writeToBinStream(fieldsToOutput, areaField);
+    }
+
+    if (shard.isTruncated()) {
+      return false;
+    }
+
+    if (stepsRead != stepsNum) {
+      logger << "Shard " << dir << " has " << stepsRead << " steps, " << stepsNum << " were written\n";
+      return false;
+    }
+
+    for (int i = 0; i < beams; ++i) {
+      for (int j = 0; j < vals; ++j) {
+        offset[i][j] += sum[i][j];
+      }
+    }
+
+    logger << "Merged " << dir << ", last step: " << lastStep << "\n";
+  }
+
+  return true;
+}
+
+int main(int argc, char **argv) {
+
+  // 0) Parse command line: "--frames a:b" processes files [a, b) only and writes
+  // a partial result, "--merge dir..." merges partial results into the usual output
+
+  UST::FrameRange range;
+  std::vector<std::string> mergeDirs;
+  bool merge = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
 
-  logger.init("ust_x.log");
+    if (merge) {
+      mergeDirs.push_back(arg);
+    } else if (arg == "--merge") {
+      merge = true;
+    } else if (arg == "--frames" && i + 1 < argc && UST::FrameRange::parse(argv[i + 1], range)) {
+      ++i;
+    } else {
+      std::cerr << "Usage: ust_x [--frames first:last | --merge shard_dir...]\n";
+      return 1;
+    }
+  }
+
+  const bool sharded = !range.isFull();
+
+  if (merge && (sharded || mergeDirs.empty())) {
+    std::cerr << "Usage: ust_x [--frames first:last | --merge shard_dir...]\n";
+    return 1;
+  }
+
+  // Shards may run at once in one directory, each one logs to its own file
+  logger.init(sharded ? "ust_x_" + range.name() + ".log" : merge ? "ust_x_merge.log" : "ust_x.log");
 
   logger << "UST XCorr " << VERSION << std::endl;
   logger << SEPARATOR;
@@ -69,25 +222,60 @@ int main() {
   const auto dir = reader.Get("processing", "raw_dir", "");
   const auto monitorConfig = reader.Get("processing", "monitoring_config", "");
 
-  // 2) Init logger
+  // Cross correlation method: "direct" or "sat" (summed-area tables)
+  const auto xCorrMethodName = reader.Get("processing", "xcorr_method", "direct");
+  UST::XCorrMethod xCorrMethod;
 
-  UST::Logger::Instance().setEnabled(true);
+  if (xCorrMethodName == "direct") {
+    xCorrMethod = UST::XCorrMethod::Direct;
+  } else if (xCorrMethodName == "sat") {
+    xCorrMethod = UST::XCorrMethod::SummedArea;
+  } else {
+    logger << "Invalid xcorr_method: " << xCorrMethodName << "\n";
+    return 1;
+  }
 
-  // 3) Allocate arrays for raw data
-  short **rawBeamData1 = new short*[beams],
-        **rawBeamData2 = new short*[beams],
-        **rawBeamDataTmp = new short*[beams];
+  // Direct cross correlation tile in beams x samples, e.g. "16x128", or "auto"
+  const auto xCorrTileName = reader.Get("processing", "xcorr_tile", "auto");
+  size_t tileBeams = 0, tileSamples = 0;
 
-  double **out = new double*[beams];
+  if (xCorrTileName != "auto" &&
+      (std::sscanf(xCorrTileName.c_str(), "%zux%zu", &tileBeams, &tileSamples) != 2 ||
+       tileBeams == 0 || tileSamples == 0)) {
+    logger << "Invalid xcorr_tile: " << xCorrTileName << "\n";
+    return 1;
+  }
 
-  for (int i = 0; i < beams; ++i) {
-    rawBeamData1[i] = new short[vals];
-    rawBeamData2[i] = new short[vals];
-    rawBeamDataTmp[i] = new short[vals];
-    out[i] = new double[vals];
+  // Number of frame pairs processed at once, more than 1 helps to load all cores
+  // when a single frame is too small for that
+  const long batchSize = reader.GetInteger("processing", "batch_size", 1);
+
+  if (batchSize < 1) {
+    logger << "Invalid batch_size: " << batchSize << "\n";
+    return 1;
+  }
+
+  // How frames are read: "read" copies them into buffers, "mmap" maps the files,
+  // "uring" reads them asynchronously with io_uring where it is built in
+  const auto frameSourceName = reader.Get("processing", "frame_source", "read");
+
+  // Number of frames the kernel is asked to read ahead of the one being read
+  const long prefetchFrames = std::max(0L, reader.GetInteger("processing", "prefetch_frames", 8));
+
+  // Number of batches in flight between reading and writing results, 1 processes
+  // batches one at a time
+  const long pipelineDepth = reader.GetInteger("processing", "pipeline_depth", 4);
+
+  if (pipelineDepth < 1) {
+    logger << "Invalid pipeline_depth: " << pipelineDepth << "\n";
+    return 1;
   }
 
-  // 4) Allocate vectors for results
+  // 2) Init logger
+
+  UST::Logger::Instance().setEnabled(true);
+
+  // 3) Allocate vectors for results
   UST::Field tempField(beams);
 
   for (size_t i = 0; i < beams; ++i) {
@@ -111,145 +299,315 @@ int main() {
     }
   }
 
-  // 5) Init XCorr engine
-  
-  UST::XCorrEngine engine(wSizeAxial, wSizeLateral, beams, vals);
-
-  // 6) Init Monitor
+  // 4) Init output: a shard only writes its partial result, otherwise results go
+  // to the monitor and PLT
 
   Monitoring::Monitor& monitor = Monitoring::Monitor::Instance();
-  monitor.init(monitorConfig, beams, vals, areaSize);
+  UST::FileManager fileManager;
+  UST::ShardWriter shardWriter;
 
-  // 7) Init file manager for output
+  if (sharded) {
+    const std::string shardDir = std::string(OUTPUT_DIR) + "/" + range.name();
 
-  UST::FileManager fileManager;
+    if (!shardWriter.open(shardDir, beams, vals)) {
+      return 1;
+    }
 
-  std::vector<std::string> varsToOutput = {"x", "z", "epsilon"};
+    logger << "Shard output: " << shardDir << "\n";
+  } else {
+    monitor.init(monitorConfig, beams, vals, areaSize);
 
-  fileManager.openBinStream(std::string(OUTPUT_DIR) + "/epsilon.plt", varsToOutput, beams, vals);
+    std::vector<std::string> varsToOutput = {"x", "z", "epsilon"};
 
-  // 8) Start processing
+    fileManager.openBinStream(std::string(OUTPUT_DIR) + "/epsilon.plt", varsToOutput, beams, vals);
+  }
 
-  // For median filter
-  double medianWindow[3];
-  double min, max;
-  int minM, maxM;
+  // 5) Merge partial results instead of processing if requested
 
-  int cnt = 0;
-  int step = 1;
+  if (merge) {
+    const bool merged = mergeShards(mergeDirs, beams, vals, monitor, fileManager, areaField);
 
-  for (const auto& p : std::filesystem::directory_iterator(dir))
-  {
-    if (p.path().extension() == ".raw") {
-      cnt++;
-
-      if (cnt == 1) {
-        UST::FileManager::readRAWFile(p.path().string(), rawBeamDataTmp, beams, vals);
-        continue;
-      } else if (cnt % skip == 0) {
-        UST::FileManager::readRAWFile(p.path().string(), rawBeamData2, beams, vals);
-
-        if (cnt % skip == 0) {
-          for (int i = 0; i < beams; ++i) {
-            for (int j = 0; j < vals; ++j) {
-              rawBeamData1[i][j] = rawBeamDataTmp[i][j];
-              rawBeamDataTmp[i][j] = rawBeamData2[i][j];
-            }
-          }
-        }
-        else {
-          break;
-        }
+    fileManager.closeBinStream();
 
-        logger << "Step: " << step << ", file number: " << cnt << std::endl;
-        step++;
-
-        // 0) Find signal shift
-        engine.calcShift(rawBeamData1, rawBeamDataTmp, out);
-
-        // 1) Median filter with a small window (3) to detect outliers
-        for (size_t i = 0; i < beams; ++i) {
-          for (size_t j = 1; j < vals - 1; ++j) {
-            min = 0;
-            max = 0;
-
-            medianWindow[0] = out[i][j - 1];
-            medianWindow[1] = out[i][j];
-            medianWindow[2] = out[i][j + 1];
-
-            min = medianWindow[0];
-            minM = 0;
-            max = medianWindow[2];
-            maxM = 2;
-
-            for (int m = 0; m < 3; ++m) {
-              if (medianWindow[m] < min) {
-                min = medianWindow[m];
-                minM = m;
-              }
-              else {
-                if (medianWindow[m] > max) {
-                  max = medianWindow[m];
-                  maxM = m;
-                }
-              }
-            }
-
-            out[i][j] = medianWindow[~(minM ^ maxM) & 3];
-          }
-        }
+    logger << (merged ? "Done!\n" : "Merge failed!\n");
+
+    return merged ? 0 : 1;
+  }
+
+  // 6) Init XCorr engine. All parallel processing runs on one pool, so that the stages
+  // running at the same time share the hardware threads instead of oversubscribing them
+  UST::Multithreading::ThreadPool tp;
 
-        // 2) Low pass axial filter
-        for (size_t i = 0; i < beams; ++i) {
-          for (size_t j = 1; j < vals; ++j) {
-            out[i][j] = out[i][j - 1] + (alpha * (out[i][j] - out[i][j - 1]));
-          }
+  // The previous frame has to survive a whole batch being added
+  UST::XCorrEngine engine(tp, wSizeAxial, wSizeLateral, beams, vals, batchSize + 1, xCorrMethod);
+
+  engine.setTile(tileBeams, tileSamples);
+
+  if (xCorrMethod == UST::XCorrMethod::Direct) {
+    logger << "XCorr tile: " << engine.getTileBeams() << " x " << engine.getTileSamples() << "\n";
+  }
+
+  // 7) Collect frames to read. Files are numbered in natural name order, so that all shards
+  // agree on the numbering. A shard also reads the last frame processed before
+  // its range, as the reference for the first one, and continues its step numbering
+
+  const auto files = UST::FileManager::listRAWFiles(dir);
+
+  std::vector<int> framesToRead;
+  int reference = 0;
+  int firstStep = 1;
+
+  for (int cnt = 1; cnt <= (int) files.size(); ++cnt) {
+    if (cnt != 1 && cnt % skip != 0) {
+      continue;
+    }
+
+    if (cnt < range.first) {
+      reference = cnt;
+
+      if (cnt != 1) {
+        firstStep++;
+      }
+    } else if (range.contains(cnt)) {
+      framesToRead.push_back(cnt);
+    }
+  }
+
+  if (reference != 0 && !framesToRead.empty()) {
+    framesToRead.insert(framesToRead.begin(), reference);
+  }
+
+  std::vector<std::string> frameFiles;
+
+  for (const int cnt : framesToRead) {
+    frameFiles.push_back(files[cnt - 1].string());
+  }
+
+  // Frames stay acquired until they are correlated, up to every frame of the batches in flight
+  auto source = UST::FrameSource::create(frameSourceName, std::move(frameFiles), beams, vals, prefetchFrames,
+                                         (size_t) (pipelineDepth * batchSize));
+
+  if (!source) {
+    logger << "Invalid frame_source: " << frameSourceName << "\n";
+    return 1;
+  }
+
+  // 8) Start processing. Batches of frames go through a pipeline of stages connected
+  // by bounded queues, so that reading and Hilbert transforming batch k + 1 overlaps
+  // with filtering and writing batch k. Batches circulate through the stages
+  // and come back to the free queue once their frames are written
+
+  const size_t depth = (size_t) pipelineDepth,
+               batchFrames = (size_t) batchSize;
+
+  std::vector<std::unique_ptr<FrameBatch>> batches;
+
+  UST::Pipeline::BoundedQueue<FrameBatch*> freeBatches(depth),
+                                           toCorrelate(depth),
+                                           toFilter(depth),
+                                           toWrite(depth);
+
+  for (size_t i = 0; i < depth; ++i) {
+    batches.emplace_back(new FrameBatch(batchFrames, beams, vals, source->needsBuffer()));
+    freeBatches.push(batches.back().get());
+  }
+
+  UST::Pipeline::StageStats readStats{"read"},
+                            correlateStats{"hilbert + xcorr"},
+                            filterStats{"filter"},
+                            writeStats{"write"};
+
+  // Hilbert transform every frame and find the shift to the previous processed one
+  int prevCnt = 0;
+  int step = firstStep;
+
+  std::vector<size_t> frameIndices, prevIndices, nextIndices;
+  std::vector<UST::FrameView> sigs;
+  std::vector<double**> outs;
+
+  auto correlate = UST::Pipeline::startStage(correlateStats, toCorrelate,
+    [&](FrameBatch *batch) {
+      frameIndices.clear();
+      prevIndices.clear();
+      nextIndices.clear();
+      sigs.clear();
+      outs.clear();
+
+      for (size_t k = 0; k < batch->size; ++k) {
+        FrameSlot *frame = batch->frames[k].get();
+
+        frameIndices.push_back(frame->cnt);
+        sigs.push_back(frame->raw);
+
+        // The first frame is a reference only
+        frame->hasShift = prevCnt != 0;
+
+        if (frame->hasShift) {
+          logger << "Step: " << step << ", file number: " << frame->cnt << std::endl;
+          step++;
+          frame->step = step;
+
+          prevIndices.push_back(prevCnt);
+          nextIndices.push_back(frame->cnt);
+          outs.push_back(frame->out.data());
         }
 
-        // 3) Low pass lateral filter
-        for (size_t j = 0; j < vals; ++j) {
-          for (size_t i = 1; i < beams; ++i) {
-            out[i][j] = out[i - 1][j] + (alpha * (out[i][j] - out[i - 1][j]));
-          }
+        prevCnt = frame->cnt;
+      }
+
+      engine.addFrames(frameIndices.data(), sigs.data(), frameIndices.size());
+
+      // Raw frames can be released once addFrames has transformed them
+      for (size_t k = 0; k < batch->size; ++k) {
+        source->release(batch->frames[k]->sourceIndex);
+      }
+
+      engine.calcShifts(prevIndices.data(), nextIndices.data(), outs.data(), outs.size());
+
+      toFilter.push(batch);
+    },
+    [&]() { toFilter.close(); });
+
+  // Filter the shifts of a batch and accumulate them in frame order. Every frame
+  // gets a copy of the accumulated field, as the next batch may be accumulated
+  // before this one is written
+  UST::PostProcessor postProcessor(tp, beams, vals, alpha, filterLength);
+
+  std::vector<double**> shifts;
+  std::vector<UST::Field*> results;
+
+  auto filter = UST::Pipeline::startStage(filterStats, toFilter,
+    [&](FrameBatch *batch) {
+      shifts.clear();
+      results.clear();
+
+      for (size_t k = 0; k < batch->size; ++k) {
+        FrameSlot *frame = batch->frames[k].get();
+
+        if (frame->hasShift) {
+          shifts.push_back(frame->out.data());
+          results.push_back(&frame->field);
         }
+      }
+
+      postProcessor.process(shifts.data(), results.data(), shifts.size(), tempField);
 
-        // 4) Low pass axial differentiator
-        for (size_t i = 0; i < beams; ++i) {
-          for (size_t j = filterLength; j < vals - filterLength; ++j) {
-            out[i][j] = 0;
+      toWrite.push(batch);
+    },
+    [&]() { toWrite.close(); });
 
-            for (int k = 1; k < filterLength + 1; ++k) {
-              out[i][j] += coeff * (out[i][j + k] - out[i][j - k]);
-            }
+  auto write = UST::Pipeline::startStage(writeStats, toWrite,
+    [&](FrameBatch *batch) {
+      for (size_t k = 0; k < batch->size; ++k) {
+        FrameSlot *frame = batch->frames[k].get();
 
-            tempField[i][j] += out[i][j];
-          }
+        if (!frame->hasShift) {
+          continue;
         }
 
-        // 5) Process monitoring points
-        monitor.process(tempField, "epsilon", std::to_string(step));
+        if (sharded) {
+          shardWriter.write(frame->step, frame->field);
+          continue;
+        }
+
+        // 1) Process monitoring points
+        monitor.process(frame->field, "epsilon", std::to_string(frame->step));
 
-        // 6) Output results to PLT
+        // 2) Output results to PLT
         std::vector<std::reference_wrapper<UST::Field>> fieldsToOutput;
-        fieldsToOutput.emplace_back(tempField);
+        fieldsToOutput.emplace_back(frame->field);
         fileManager.writeToBinStream(fieldsToOutput, areaField);
       }
+
+      freeBatches.push(batch);
+    },
+    []() {});
+
+  // Read frames on a dedicated I/O thread, ahead of the processing as far as free
+  // batches allow, so that the stages don't wait for the disk. A frame that can't
+  // be read stops the processing, frames read before it are still processed and written
+  bool readFailed = false;
+
+  std::thread io([&]() {
+    FrameBatch *batch = nullptr;
+
+    for (size_t k = 0; k < framesToRead.size(); ++k) {
+      auto start = UST::Pipeline::Clock::now();
+
+      if (batch == nullptr) {
+        freeBatches.pop(batch);
+        batch->size = 0;
+      }
+
+      readStats.idle += UST::Pipeline::secondsSince(start);
+
+      start = UST::Pipeline::Clock::now();
+      FrameSlot *frame = batch->frames[batch->size++].get();
+
+      frame->cnt = framesToRead[k];
+      frame->sourceIndex = k;
+
+      if (!source->acquire(k, frame->rawData.data(), frame->raw)) {
+        batch->size--;
+        readFailed = true;
+        break;
+      }
+
+      readStats.busy += UST::Pipeline::secondsSince(start);
+
+      if (batch->size == batchFrames) {
+        readStats.items++;
+        toCorrelate.push(batch);
+        batch = nullptr;
+      }
+    }
+
+    // The last batch may be incomplete
+    if (batch != nullptr) {
+      readStats.items++;
+      toCorrelate.push(batch);
     }
+
+    toCorrelate.close();
+  });
+
+  io.join();
+  correlate.join();
+  filter.join();
+  write.join();
+
+  // 9) Report how the stages were loaded: a stage that is never idle while the others
+  // wait for their input is the bottleneck, depth beyond the number of stages only helps
+  // when stage times vary from frame to frame
+
+  logger << "Pipeline depth: " << depth << ", batch size: " << batchFrames << "\n";
+
+  const UST::Pipeline::StageStats *stageStats[] = {&readStats, &correlateStats, &filterStats, &writeStats};
+  const UST::Pipeline::BoundedQueue<FrameBatch*> *inputs[] = {&freeBatches, &toCorrelate, &toFilter, &toWrite};
+
+  for (size_t i = 0; i < 4; ++i) {
+    char line[256];
+
+    std::snprintf(line, sizeof(line),
+                  "  %-16s %5zu items, busy %8.3f s, idle %8.3f s, input queue %.2f avg / %zu max\n",
+                  stageStats[i]->name.c_str(), stageStats[i]->items, stageStats[i]->busy,
+                  stageStats[i]->idle, inputs[i]->getAverageOccupancy(), inputs[i]->getMaxOccupancy());
+    logger << line;
   }
 
-  for (int i = 0; i < beams; ++i) {
-    delete rawBeamData1[i];
-    delete rawBeamData2[i];
-    delete rawBeamDataTmp[i];
-    delete out[i];
+  if (!sharded) {
+    fileManager.closeBinStream();
   }
 
-  delete[] out;
-  delete[] rawBeamData1;
-  delete[] rawBeamData2;
-  delete[] rawBeamDataTmp;
+  if (readFailed) {
+    logger << "Stopped at an unreadable frame!\n";
+    return 1;
+  }
 
-  fileManager.closeBinStream();
+  // The end-of-shard sum marks the shard complete, so it is written only on success
+  if (sharded && !shardWriter.close(tempField)) {
+    return 1;
+  }
 
   logger << "Done!\n";
   
@@ -0,0 +1,107 @@
+#include <post_processor.h>
+
+#include <FIR.h>
+
+#include <algorithm>
+
+UST::PostProcessor::PostProcessor(
+  UST::Multithreading::ThreadPool& tp_, size_t beams_, size_t vals_, double alpha_, size_t filterLength_) :
+    beams(beams_),
+    vals(vals_),
+    alpha(alpha_),
+    filterLength(filterLength_),
+    tp(tp_)
+{
+    strain.resize(tp.maxParticipants() * vals);
+}
+
+void UST::PostProcessor::smoothAxial(double *row) const {
+  // Median filter with a small window (3) to detect outliers. It runs in place,
+  // so the window starts with the previous median, kept here as the low pass
+  // filter overwrites it right away
+  double medianWindow[3];
+  double min, max;
+  int minM, maxM;
+
+  double prevMedian = row[0];
+
+  for (size_t j = 1; j < vals; ++j) {
+    double median = row[j];
+
+    if (j < vals - 1) {
+      medianWindow[0] = prevMedian;
+      medianWindow[1] = row[j];
+      medianWindow[2] = row[j + 1];
+
+      min = medianWindow[0];
+      minM = 0;
+      max = medianWindow[2];
+      maxM = 2;
+
+      for (int m = 0; m < 3; ++m) {
+        if (medianWindow[m] < min) {
+          min = medianWindow[m];
+          minM = m;
+        }
+        else {
+          if (medianWindow[m] > max) {
+            max = medianWindow[m];
+            maxM = m;
+          }
+        }
+      }
+
+      median = medianWindow[~(minM ^ maxM) & 3];
+    }
+
+    prevMedian = median;
+
+    // Low pass axial filter
+    row[j] = row[j - 1] + (alpha * (median - row[j - 1]));
+  }
+}
+
+void UST::PostProcessor::process(double ***shifts, Field **results, size_t count, Field& sum) {
+  // 1) Axial smoothing, beams of all fields are independent
+
+  tp.parallelFor(0, count * beams, 4, [this, shifts](size_t begin, size_t end, size_t) {
+    for (size_t t = begin; t < end; ++t) {
+      this->smoothAxial(shifts[t / beams][t % beams]);
+    }
+  });
+
+  // 2) Lateral smoothing, blocks of columns are independent and every block
+  // is filtered row by row
+
+  const size_t blocks = (vals + lateralBlock - 1) / lateralBlock;
+
+  tp.parallelFor(0, count * blocks, 1, [this, shifts, blocks](size_t begin, size_t end, size_t) {
+    for (size_t t = begin; t < end; ++t) {
+      const size_t colBegin = t % blocks * lateralBlock;
+
+      dsperado::FIR::lowPass2D(shifts[t / blocks], beams, colBegin, std::min(colBegin + lateralBlock, vals), alpha);
+    }
+  });
+
+  // 3) Differentiate and accumulate in frame order, fused per beam. Every sample is
+  // summed in the same order as frame by frame, so the result does not depend on count.
+  // Samples closer than filterLength to the beam ends are not accumulated
+
+  tp.parallelFor(0, beams, 4, [this, shifts, results, count, &sum](size_t begin, size_t end, size_t slot) {
+    double *row = strain.data() + slot * vals;
+
+    for (size_t i = begin; i < end; ++i) {
+      auto& acc = sum[i];
+
+      for (size_t k = 0; k < count; ++k) {
+        dsperado::FIR::smoothedDD1(shifts[k][i], row, vals, filterLength);
+
+        for (size_t j = filterLength; j < vals - filterLength; ++j) {
+          acc[j] += row[j];
+        }
+
+        (*results[k])[i] = acc;
+      }
+    }
+  });
+}
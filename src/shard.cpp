@@ -0,0 +1,196 @@
+#include <shard.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+
+#include <logger.h>
+
+static const char stepsFile[] = "steps.bin";
+static const char sumFile[] = "sum.bin";
+
+// Both files start with a magic word and the field dimensions
+static const uint32_t magic = 0x44525355; // "USRD"
+
+static void writeHeader(std::ofstream& out, int beams, int vals) {
+  const uint32_t header[3] = {magic, (uint32_t) beams, (uint32_t) vals};
+
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+static bool checkHeader(std::ifstream& in, int beams, int vals) {
+  uint32_t header[3];
+
+  in.read(reinterpret_cast<char*>(header), sizeof(header));
+
+  return in && header[0] == magic && header[1] == (uint32_t) beams && header[2] == (uint32_t) vals;
+}
+
+static void writeField(std::ofstream& out, const UST::Field& field, int vals) {
+  for (auto& row : field) {
+    out.write(reinterpret_cast<const char*>(row.data()), vals * sizeof(double));
+  }
+}
+
+static bool readField(std::ifstream& in, UST::Field& field, int beams, int vals) {
+  field.resize(beams);
+
+  for (auto& row : field) {
+    row.resize(vals);
+    in.read(reinterpret_cast<char*>(row.data()), vals * sizeof(double));
+  }
+
+  return (bool) in;
+}
+
+bool UST::FrameRange::parse(const std::string& text, FrameRange& range) {
+  const auto colon = text.find(':');
+
+  if (colon == std::string::npos) {
+    return false;
+  }
+
+  const std::string first = text.substr(0, colon),
+                    last = text.substr(colon + 1);
+
+  FrameRange parsed;
+  char tail;
+
+  if (!first.empty() && std::sscanf(first.c_str(), "%d%c", &parsed.first, &tail) != 1) {
+    return false;
+  }
+
+  if (!last.empty() && std::sscanf(last.c_str(), "%d%c", &parsed.last, &tail) != 1) {
+    return false;
+  }
+
+  if (parsed.first < 1 || parsed.last <= parsed.first) {
+    return false;
+  }
+
+  range = parsed;
+
+  return true;
+}
+
+std::string UST::FrameRange::name() const {
+  return "shard_" + std::to_string(first) + "_" + (last == INT_MAX ? std::string("end") : std::to_string(last));
+}
+
+bool UST::ShardWriter::open(const std::string& dir_, int beams_, int vals_) {
+  dir = dir_;
+  beams = beams_;
+  vals = vals_;
+
+  std::filesystem::create_directories(dir);
+
+  // A sum left by an earlier run would mark the shard complete even if this run fails
+  std::error_code error;
+  std::filesystem::remove(std::filesystem::path(dir) / sumFile, error);
+
+  if (error) {
+    logger << "Error removing " << sumFile << " of shard " << dir << ": " << error.message() << std::endl;
+    return false;
+  }
+
+  steps.open(std::filesystem::path(dir) / stepsFile, std::ios::binary | std::ios::trunc);
+
+  if (!steps.is_open()) {
+    logger << "Error opening shard output " << dir << std::endl;
+    return false;
+  }
+
+  writeHeader(steps, beams, vals);
+  written = 0;
+
+  return (bool) steps;
+}
+
+bool UST::ShardWriter::write(int step, const Field& field) {
+  const int32_t label = step;
+
+  steps.write(reinterpret_cast<const char*>(&label), sizeof(label));
+  writeField(steps, field, vals);
+  written++;
+
+  return (bool) steps;
+}
+
+bool UST::ShardWriter::close(const Field& sum) {
+  steps.close();
+
+  // The sum is written last, so its presence marks a complete shard. The number
+  // of steps tells a complete steps.bin from a truncated one
+  std::ofstream out(std::filesystem::path(dir) / sumFile, std::ios::binary | std::ios::trunc);
+  const int32_t stepsNum = written;
+
+  writeHeader(out, beams, vals);
+  out.write(reinterpret_cast<const char*>(&stepsNum), sizeof(stepsNum));
+  writeField(out, sum, vals);
+
+  if (!out || !steps) {
+    logger << "Error writing shard output " << dir << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool UST::ShardReader::open(const std::string& dir_, int beams_, int vals_) {
+  dir = dir_;
+  beams = beams_;
+  vals = vals_;
+
+  if (!std::filesystem::exists(std::filesystem::path(dir) / sumFile)) {
+    logger << "Shard " << dir << " is incomplete\n";
+    return false;
+  }
+
+  steps.open(std::filesystem::path(dir) / stepsFile, std::ios::binary);
+
+  if (!steps.is_open() || !checkHeader(steps, beams, vals)) {
+    logger << "Invalid shard " << dir << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool UST::ShardReader::next(int& step, Field& field) {
+  int32_t label;
+
+  steps.read(reinterpret_cast<char*>(&label), sizeof(label));
+
+  // The end of the file between steps is the end of the shard
+  if (steps.gcount() == 0 && steps.eof()) {
+    return false;
+  }
+
+  if (!steps || !readField(steps, field, beams, vals)) {
+    logger << "Shard " << dir << " ends with a truncated step\n";
+    truncated = true;
+    return false;
+  }
+
+  step = label;
+
+  return true;
+}
+
+bool UST::ShardReader::readSum(Field& sum, int& stepsNum) {
+  std::ifstream in(std::filesystem::path(dir) / sumFile, std::ios::binary);
+  int32_t count = 0;
+
+  if (checkHeader(in, beams, vals)) {
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+  }
+
+  if (!in || count < 0 || !readField(in, sum, beams, vals)) {
+    logger << "Invalid shard sum " << dir << "\n";
+    return false;
+  }
+
+  stepsNum = count;
+
+  return true;
+}
@@ -2,152 +2,278 @@
 
 #include <XCorr.h>
 #include <HilbertTransformer.h>
+#include <CpuFeatures.h>
 
 #include <algorithm>
 
 // Defected samples in beam number 
 static const size_t defects = 14;
 
-UST::XCorrEngine::XCorrEngine(size_t window_size_axial_, size_t window_size_lateral_, size_t size1_, size_t size2_) :
-    window_size_axial(window_size_axial_),
+UST::XCorrEngine::XCorrEngine(
+  UST::Multithreading::ThreadPool& tp_,
+  size_t window_size_axial_, size_t window_size_lateral_, size_t size1_, size_t size2_, size_t historySize,
+  XCorrMethod method_) :
+    hFields(std::max(historySize, (size_t) 2), [size1_, size2_] { return SplitField(size1_, size2_); }),
     window_size_lateral(window_size_lateral_),
-    window_size_by_2_axial(window_size_axial_ / 2),
+    window_size_axial(window_size_axial_),
     window_size_by_2_lateral(window_size_lateral_ / 2),
+    window_size_by_2_axial(window_size_axial_ / 2),
     size1(size1_),
-    size2(size2_)
+    size2(size2_),
+    windowRows(window_size_lateral_ - window_size_lateral_ / 2),
+    windowCols(window_size_axial_ - window_size_axial_ / 2),
+    method(method_),
+    tp(tp_)
 {
+    if (method == XCorrMethod::SummedArea) {
+        satRows = size1 + windowRows;
+        satPitch = size2 + windowCols;
 
-    windows = new Complex**[2 * numTasks];
-
-    for (size_t i = 0; i < 2 * numTasks; ++i) {
-        windows[i] = new Complex*[window_size_lateral_];
-
-        for (size_t j = 0; j < window_size_lateral_; ++j) {
-            windows[i][j] = new Complex[window_size_axial_];
+        for (auto& table : sat) {
+            table.assign(satRows * satPitch, Complex{0, 0});
         }
     }
 
-    hField1 = new Complex*[size1];
-    hField2 = new Complex*[size1];
+    windows = SplitField(2 * tp.maxParticipants() * windowRows, windowCols);
 
-    for (size_t i = 0; i < size1; ++i) {
-        hField1[i] = new Complex[size2];
-        hField2[i] = new Complex[size2];
-    }
+    autoTile();
 }
 
-UST::XCorrEngine::~XCorrEngine() {
-    for (size_t i = 0; i < 2 * numTasks; ++i) {
-        for (size_t j = 0; j < window_size_lateral; ++j) {
-            delete[] windows[i][j];
-        }
+void UST::XCorrEngine::autoTile() {
+  // Two fields of double real and imaginary parts
+  const size_t bytesPerSample = 2 * 2 * sizeof(double),
+               budget = dsperado::cacheSizeL2() / 2,
+               width = size2 - defects;
 
-        delete[] windows[i];
-    }
+  tileCols = std::min(width, (size_t) 128);
+
+  const size_t rowBytes = (tileCols + windowCols - 1) * bytesPerSample,
+               fitRows = budget / rowBytes;
+
+  tileRows = fitRows > windowRows ? fitRows - (windowRows - 1) : 1;
+  tileRows = std::min(tileRows, size1);
+
+  // A few tiles per thread let dynamic scheduling even out the border tiles
+  const size_t minTiles = 4 * tp.maxParticipants();
 
-    delete[] windows;
+  auto tiles = [this, width] {
+    return ((size1 + tileRows - 1) / tileRows) * ((width + tileCols - 1) / tileCols);
+  };
 
-    for (size_t i = 0; i < size1; ++i) {
-        delete[] hField1[i];
-        delete[] hField2[i];
+  while (tiles() < minTiles) {
+    if (tileRows > 2 * windowRows) {
+      tileRows = (tileRows + 1) / 2;
+    } else if (tileCols > 32) {
+      tileCols /= 2;
+    } else {
+      break;
     }
+  }
+}
+
+void UST::XCorrEngine::setTile(size_t beams, size_t samples) {
+  if (beams == 0 || samples == 0) {
+    autoTile();
+    return;
+  }
 
-    delete[] hField1;
-    delete[] hField2;
+  tileRows = std::min(beams, size1);
+  tileCols = std::min(samples, size2 - defects);
 }
 
 void UST::XCorrEngine::hilbertTask(
-      short **sig1,
-      short **sig2,
+      const FrameView& sig,
+      SplitField& hField,
       const size_t begin,
       const size_t end)
 {
   thread_local static dsperado::HilbertTransformer<double> ht(size2);
-  thread_local static UST::Complex *hIn = new Complex[size2];
-  size_t i, j;
-
-  double mean1 = 0, mean2 = 0;
 
-  for (i = begin; i < end; ++i) {
+  // Every beam is centered by its own mean, so the result of a beam does not
+  // depend on how beams are chunked between threads
+  auto center = [this, &sig, &hField](size_t i) {
+    const short *beam = sig.row(i);
+    double *re = hField.re(i);
+    double mean = 0;
 
-    // 1) Fix signal means
-    
-    for (j = defects; j < size2; ++j) {
-      mean1 += sig1[i][j];
-      mean2 += sig2[i][j];
+    for (size_t j = defects; j < size2; ++j) {
+      mean += beam[j];
     }
 
-    mean1 /= size2 - defects;
-    mean2 /= size2 - defects;
+    mean /= size2 - defects;
 
-    // 2) Perform Hilbert transform
-    
-    for (j = defects; j < size2; ++j) {
-      hIn[j].r = sig1[i][j] - mean1;
-      hIn[j].i = 0;
+    for (size_t j = defects; j < size2; ++j) {
+      re[j] = beam[j] - mean;
     }
+  };
+
+  // Centered signals are written straight into the real planes, which are the inputs
+  // of the transform; beams are transformed in pairs packed into one complex FFT
+  for (size_t i = begin; i < end; i += 2) {
+    const bool pair = i + 1 < end;
 
-    ht.transform(hIn, hField1[i]);
+    // 1) Fix signal means, defected samples stay zeroed
+    
+    center(i);
 
-    for (j = defects; j < size2; ++j) {
-      hIn[j].r = sig2[i][j] - mean2;
-      hIn[j].i = 0;
+    if (pair) {
+      center(i + 1);
     }
 
-    ht.transform(hIn, hField2[i]);
+    // 2) Perform Hilbert transform into the imaginary planes
+    
+    if (pair) {
+      ht.transformImag(hField.re(i), hField.re(i + 1), hField.im(i), hField.im(i + 1));
+    } else {
+      ht.transformImag(hField.re(i), hField.im(i));
+    }
   }
 }
 
-void UST::XCorrEngine::xCorrTask(const size_t begin, const size_t end, size_t taskId) {
+void UST::XCorrEngine::xCorrTask(
+  const SplitField& hField1,
+  const SplitField& hField2,
+  double **out,
+  const size_t rowBegin,
+  const size_t rowEnd,
+  const size_t colBegin,
+  const size_t colEnd,
+  size_t slot)
+{
+  using View = dsperado::SplitView2D<double>;
 
-  // 1) Get windows pointers corresponding to taskId
+  // 1) Get views of the fields and of the windows corresponding to slot
   
-  auto window1 = this->windows[taskId * 2];
-  auto window2 = this->windows[taskId * 2 + 1];
+  const View field1 = hField1.view(),
+             field2 = hField2.view();
 
-  double tmp1, tmp2;
+  const size_t windowRow1 = slot * 2 * windowRows,
+               windowRow2 = windowRow1 + windowRows;
 
-  Complex xCorrRes;
+  const View windowView1 = windows.tile(windowRow1, 0, windowRows, windowCols),
+             windowView2 = windows.tile(windowRow2, 0, windowRows, windowCols);
 
-  for (size_t n = begin; n < end; ++n) {
-    for (size_t m = defects; m < size2; ++m) {
+  double tmp1, tmp2;
 
-      size_t wj = 0, wk = 0;
+  dsperado::XCorr::XCorrLags<double> xCorrRes;
 
-      // 2) Window the hFields
+  for (size_t n = rowBegin; n < rowEnd; ++n) {
+    for (size_t m = colBegin; m < colEnd; ++m) {
+      const View *view1 = &field1, *view2 = &field2;
+      long row = n, col = m;
+
+      // 2) Windows crossing the field borders are copied with clamping,
+      // the rest are correlated in place
       
-      for (long j = (long)n - window_size_by_2_lateral; j < (long)n + window_size_by_2_lateral; ++j) {
-        for (long k = (long)m - window_size_by_2_axial; k < (long)m + window_size_by_2_axial; ++k) {
-          auto realJ = std::min((long)size1 - 1, std::max(j, (long)0));
-          auto realK = std::min((long)size2 - 1, std::max(k, (long)0));
-
-          window1[wj][wk] = hField1[realJ][realK];
-          window2[wj][wk] = hField2[realJ][realK];
-          wk++;
+      if (n + windowRows > size1 || m + windowCols > size2) {
+        for (size_t wj = 0; wj < windowRows; ++wj) {
+          const size_t realJ = std::min(size1 - 1, n + wj);
+
+          for (size_t wk = 0; wk < windowCols; ++wk) {
+            const size_t realK = std::min(size2 - 1, m + wk);
+
+            windows.set(windowRow1 + wj, wk, hField1.at(realJ, realK));
+            windows.set(windowRow2 + wj, wk, hField2.at(realJ, realK));
+          }
         }
 
-        wj++;
-        wk = 0;
+        view1 = &windowView1;
+        view2 = &windowView2;
+        row = 0;
+        col = 0;
       }
 
-      // 3) Calc XCorrelations with different lags
+      // 3) Calc XCorrelations with different lags in one pass
+
+      xCorrRes = dsperado::XCorr::XCorr2DComplex3Lags<double>(
+        *view1, *view2, row, col, windowRows, windowCols);
+
+      tmp1 = std::atan2(xCorrRes.lag0.i, xCorrRes.lag0.r);
+      tmp2 = std::atan2(xCorrRes.lagPlus1.i, xCorrRes.lagPlus1.r) -
+             std::atan2(xCorrRes.lagMinus1.i, xCorrRes.lagMinus1.r);
+
+      out[n][m] = tmp1 / tmp2;
+    }
+  }
+}
+
+void UST::XCorrEngine::satRowsTask(
+  const SplitField& hField1,
+  const SplitField& hField2,
+  const size_t begin,
+  const size_t end)
+{
+  static const int lags[3] = { 0, 1, -1 };
+
+  const long lastRow = (long) size1 - 1,
+             lastCol = (long) size2 - 1;
+
+  // Table row j + 1 accumulates extended field row j
+  for (size_t j = begin; j < end; ++j) {
+    auto realJ = std::min((long) j, lastRow);
+    const double *re1 = hField1.re(realJ), *im1 = hField1.im(realJ),
+                 *re2 = hField2.re(realJ), *im2 = hField2.im(realJ);
+
+    for (int l = 0; l < 3; ++l) {
+      Complex *row = &sat[l][(j + 1) * satPitch];
+      Complex acc = {0, 0};
+
+      row[0] = acc;
+
+      for (size_t k = 0; k + 1 < satPitch; ++k) {
+        const long k1 = std::min((long) k, lastCol),
+                   k2 = std::min(std::max((long) k + lags[l], (long) 0), lastCol);
 
-      xCorrRes = dsperado::XCorr::XCorr2DComplex<double>(
-        window1, window2,
-        window_size_lateral, window_size_axial,
-        window_size_by_2_lateral, window_size_by_2_axial, 0);
+        acc.r += re1[k1] * re2[k2] + im1[k1] * im2[k2];
+        acc.i += -re1[k1] * im2[k2] + im1[k1] * re2[k2];
+
+        row[k + 1] = acc;
+      }
+    }
+  }
+}
+
+void UST::XCorrEngine::satColumnsTask(const size_t begin, const size_t end) {
+  for (auto& table : sat) {
+    for (size_t j = 2; j < satRows; ++j) {
+      const Complex *prev = &table[(j - 1) * satPitch];
+      Complex *row = &table[j * satPitch];
+
+      for (size_t k = begin; k < end; ++k) {
+        row[k].r += prev[k].r;
+        row[k].i += prev[k].i;
+      }
+    }
+  }
+}
+
+void UST::XCorrEngine::satXCorrTask(double **out, const size_t begin, const size_t end) {
+  const size_t rows = windowRows,
+               cols = windowCols;
+
+  // Sum over table rows [r0, r1) and columns [c0, c1)
+  auto windowSum = [this](const std::vector<Complex>& table, size_t r0, size_t r1, size_t c0, size_t c1) {
+    const Complex *top = &table[r0 * satPitch], *bottom = &table[r1 * satPitch];
+    Complex sum;
+
+    sum.r = bottom[c1].r - bottom[c0].r - top[c1].r + top[c0].r;
+    sum.i = bottom[c1].i - bottom[c0].i - top[c1].i + top[c0].i;
+
+    return sum;
+  };
+
+  Complex xCorrRes;
+  double tmp1, tmp2;
+
+  for (size_t n = begin; n < end; ++n) {
+    for (size_t m = defects; m < size2; ++m) {
+      xCorrRes = windowSum(sat[0], n, n + rows, m, m + cols);
       tmp1 = std::atan2(xCorrRes.i, xCorrRes.r);
 
-      xCorrRes = dsperado::XCorr::XCorr2DComplex<double>(
-        window1, window2,
-        window_size_lateral, window_size_axial,
-        window_size_by_2_lateral, window_size_by_2_axial, 1);
+      xCorrRes = windowSum(sat[1], n, n + rows, m, m + cols - 1);
       tmp2 = std::atan2(xCorrRes.i, xCorrRes.r);
 
-      xCorrRes = dsperado::XCorr::XCorr2DComplex<double>(
-        window1, window2,
-        window_size_lateral, window_size_axial,
-        window_size_by_2_lateral, window_size_by_2_axial, -1);
+      xCorrRes = windowSum(sat[2], n, n + rows, m + 1, m + cols);
       tmp2 -= std::atan2(xCorrRes.i, xCorrRes.r);
 
       out[n][m] = tmp1 / tmp2;
@@ -155,44 +281,122 @@ void UST::XCorrEngine::xCorrTask(const size_t begin, const size_t end, size_t ta
   }
 }
 
-void UST::XCorrEngine::calcShift(
-  short **sig1,
-  short **sig2,
+const UST::XCorrEngine::SplitField *UST::XCorrEngine::findHField(size_t frameIndex) const {
+  return hFields.find(frameIndex);
+}
+
+void UST::XCorrEngine::addFrame(size_t frameIndex, const FrameView& sig) {
+  addFrames(&frameIndex, &sig, 1);
+}
+
+void UST::XCorrEngine::addFrames(const size_t *frameIndices, const FrameView *sigs, size_t count) {
+  // 1) Pick slots for all frames first, so that the ring is not modified by the tasks
+
+  std::vector<SplitField*> targets(count);
+
+  for (size_t k = 0; k < count; ++k) {
+    targets[k] = &hFields.acquire(frameIndices[k]);
+  }
+
+  // 2) Perform parallelized Hilbert transform of all frames at once.
+  // Tasks are whole beam pairs, as pairs share one FFT
+
+  const size_t beamPairs = (size1 + 1) / 2;
+  SplitField **hFieldsOut = targets.data();
+
+  tp.parallelFor(0, count * beamPairs, 1,
+    [this, sigs, hFieldsOut, beamPairs](size_t begin, size_t end, size_t) {
+      for (size_t p = begin; p < end; ++p) {
+        const size_t k = p / beamPairs,
+                     beam = p % beamPairs * 2;
+
+        this->hilbertTask(sigs[k], *hFieldsOut[k], beam, std::min(beam + 2, size1));
+      }
+    });
+}
+
+bool UST::XCorrEngine::calcShift(
+  size_t frameIndex1,
+  size_t frameIndex2,
   double **out)
 {
-  this->out = out;
-
-  // 1) Perform parallelized Hilbert transform
+  return calcShifts(&frameIndex1, &frameIndex2, &out, 1);
+}
 
-  this->tp.startTaskBlock(numThreads);
+bool UST::XCorrEngine::calcShifts(
+  const size_t *frameIndices1,
+  const size_t *frameIndices2,
+  double ***outs,
+  size_t count)
+{
+  std::vector<const SplitField*> fields(2 * count);
 
-  for (size_t i = 0; i < numThreads; ++i) {
-    auto begin = i * pieceSize,
-         end = begin + pieceSize;
+  for (size_t k = 0; k < count; ++k) {
+    fields[2 * k] = findHField(frameIndices1[k]);
+    fields[2 * k + 1] = findHField(frameIndices2[k]);
 
-    this->tp.runTask(&UST::XCorrEngine::hilbertTask, this, sig1, sig2, begin, end);
+    if (fields[2 * k] == nullptr || fields[2 * k + 1] == nullptr) {
+      return false;
+    }
   }
 
-  if (div != 0) {
-    this->hilbertTask(sig1, sig2, size1 - div, size1);
+  // Shift is not estimated for the first defects samples of every beam, zero them
+  // so that out does not carry values from previous frames into the filters
+  for (size_t k = 0; k < count; ++k) {
+    for (size_t n = 0; n < size1; ++n) {
+      std::fill(outs[k][n], outs[k][n] + defects, 0.0);
+    }
   }
 
-  this->tp.wait();
+  if (method == XCorrMethod::SummedArea) {
+    // There is a single set of tables, so pairs are processed one by one
+    for (size_t k = 0; k < count; ++k) {
+      const SplitField *hField1 = fields[2 * k],
+                       *hField2 = fields[2 * k + 1];
+      double **out = outs[k];
 
-  // 2) Perform parallelized cross correlation
+      // 1) Build summed-area tables: lagged products with prefix sums along rows,
+      // then prefix sums along columns
 
-  this->tp.startTaskBlock(numThreads);
+      tp.parallelFor(0, satRows - 1, 4, [this, hField1, hField2](size_t begin, size_t end, size_t) {
+        this->satRowsTask(*hField1, *hField2, begin, end);
+      });
 
-  for (size_t i = 0; i < numThreads; ++i) {
-    auto begin = i * pieceSize,
-         end = begin + pieceSize;
+      tp.parallelFor(0, satPitch, 64, [this](size_t begin, size_t end, size_t) {
+        this->satColumnsTask(begin, end);
+      });
 
-    this->tp.runTask(&UST::XCorrEngine::xCorrTask, this, begin, end, i);
-  }
+      // 2) Read window sums from the tables
+
+      tp.parallelFor(0, size1, 1, [this, out](size_t begin, size_t end, size_t) {
+        this->satXCorrTask(out, begin, end);
+      });
+    }
 
-  if (div != 0) {
-    this->xCorrTask(size1 - div, size1, numThreads);
+    return true;
   }
 
-  this->tp.wait();
+  // Perform parallelized cross correlation over 2D tiles of all outputs at once,
+  // so that small frames still give every thread enough tiles
+
+  const size_t width = size2 - defects,
+               tilesAcross = (width + tileCols - 1) / tileCols,
+               tilesPerFrame = (size1 + tileRows - 1) / tileRows * tilesAcross;
+  const SplitField **pairs = fields.data();
+
+  tp.parallelFor(0, count * tilesPerFrame, 1,
+    [this, pairs, outs, tilesAcross, tilesPerFrame](size_t begin, size_t end, size_t slot) {
+      for (size_t t = begin; t < end; ++t) {
+        const size_t k = t / tilesPerFrame,
+                     tile = t % tilesPerFrame,
+                     row = tile / tilesAcross * tileRows,
+                     col = defects + tile % tilesAcross * tileCols;
+
+        this->xCorrTask(*pairs[2 * k], *pairs[2 * k + 1], outs[k],
+                        row, std::min(row + tileRows, size1),
+                        col, std::min(col + tileCols, size2), slot);
+      }
+    });
+
+  return true;
 }